@@ -0,0 +1,520 @@
+/**
+ * Headless host build of the Karl Eido renderer
+ *
+ * Compiles karl-eido.c against the shim in host/shim, renders every symmetry group, side
+ * length, render mode and line/center combination with draw_pattern(), times each frame with
+ * the monotonic clock and optionally writes the frames as PBM files for pixel diffs between
+ * builds. With -k it runs the kernel benchmark instead, which writes
+ * ext/apps_data/karl_eido/kernels.csv below the working directory and reports regressions
+ * against the baseline next to it; -K also fails on them, for machines quiet enough to tell.
+ * With -s it measures the stack the render worker jobs and the main loop work take, each on a
+ * painted thread stack. With -p it builds the geometry at
+ * every pan origin of every side length and group (or the ones given with -a and -g) and
+ * fails if one does not fit into GEOMETRY_ARENA_SIZE.
+ *
+ * Usage: karl_host [-k|-K] [-s] [-p] [-o DIR] [-n FRAMES] [-a SIDE_LENGTH] [-m lattice|tile|filled] [-g GROUP]
+ */
+
+#include "../karl-eido.c"
+
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#define HOST_DEFAULT_FRAMES 32
+#define HOST_MAX_FRAMES 1024
+#define HOST_PROBE_STACK (256 * 1024)
+#define HOST_PROBE_FILL 0xA5
+#define HOST_PROBE_DEPTH 2
+
+Canvas* host_canvas_alloc(void);
+
+static uint64_t host_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+static int host_compare_u64(const void* a, const void* b) {
+    uint64_t left = *(const uint64_t*)a;
+    uint64_t right = *(const uint64_t*)b;
+    return (left > right) - (left < right);
+}
+
+/**
+ * Write a frame in the display layout as binary PBM (P4), 1 is black
+ */
+static bool host_write_pbm(const char* path, const uint8_t* frame) {
+    FILE* file = fopen(path, "wb");
+    if(file == NULL) return false;
+    
+    fprintf(file, "P4\n%d %d\n", SCREEN_WIDTH, SCREEN_HEIGHT);
+    for(int y = 0; y < SCREEN_HEIGHT; y++) {
+        uint8_t row[SCREEN_WIDTH / 8] = {0};
+        for(int x = 0; x < SCREEN_WIDTH; x++) {
+            if(frame[(y / 8) * SCREEN_WIDTH + x] & (1 << (y % 8))) {
+                row[x / 8] |= (uint8_t)(0x80 >> (x % 8));
+            }
+        }
+        fwrite(row, 1, sizeof(row), file);
+    }
+    
+    return fclose(file) == 0;
+}
+
+typedef struct {
+    void* (*function)(void*);
+    void* argument;
+    size_t used; // High-water mark of the stack in bytes, less what an empty thread takes
+} HostProbe;
+
+static size_t host_probe_base;
+
+static void* host_probe_empty(void* argument) {
+    return argument;
+}
+
+/**
+ * Run a function on a thread whose stack was painted with HOST_PROBE_FILL and measure how
+ * deep it got. The stack grows down, the first byte changed from the bottom is the mark.
+ * Probes nest, the main loop work runs the worker jobs on a probe of their own. The thread
+ * control block glibc keeps at the top of the stack is measured once and taken off.
+ */
+static bool host_stack_probe(HostProbe* probe) {
+    static uint8_t stacks[HOST_PROBE_DEPTH][HOST_PROBE_STACK] __attribute__((aligned(64)));
+    static int depth;
+    if(depth == HOST_PROBE_DEPTH) return false;
+    uint8_t* stack = stacks[depth++];
+    memset(stack, HOST_PROBE_FILL, HOST_PROBE_STACK);
+    
+    pthread_attr_t attributes;
+    pthread_t thread;
+    pthread_attr_init(&attributes);
+    pthread_attr_setstack(&attributes, stack, HOST_PROBE_STACK);
+    bool started = pthread_create(&thread, &attributes, probe->function, probe->argument) == 0;
+    pthread_attr_destroy(&attributes);
+    if(started) pthread_join(thread, NULL);
+    depth--;
+    if(!started) return false;
+    
+    size_t untouched = 0;
+    while(untouched < HOST_PROBE_STACK && stack[untouched] == HOST_PROBE_FILL) untouched++;
+    size_t used = HOST_PROBE_STACK - untouched;
+    if(probe->function == host_probe_empty) host_probe_base = used;
+    probe->used = MAX(probe->used, used > host_probe_base ? used - host_probe_base : 0);
+    return true;
+}
+
+static size_t host_worker_stack;
+
+// One info line, what the app's own formatting costs in libc
+static void* host_format(void* argument) {
+    char line[INFO_LINE_SIZE];
+    snprintf(line, sizeof(line), "S:%" PRIu32 "/%" PRIu32 "/%" PRIu32 " H:%" PRIu32 "k M:%d%%", (uint32_t)612,
+             (uint32_t)188, (uint32_t)1024, (uint32_t)96, 42);
+    *(volatile char*)argument = line[0];
+    return NULL;
+}
+
+static void* host_worker_job(void* argument) {
+    render_worker_run(&((AppState*)argument)->worker);
+    return NULL;
+}
+
+/**
+ * Hand out render worker jobs until the worker is idle, every job runs on a probe stack
+ */
+static void host_worker_drain(AppState* state) {
+    HostProbe probe = {host_worker_job, state, 0};
+    for(int job = 0; job < 4; job++) {
+        render_worker_schedule(state);
+        if(state->worker.work == RenderWorkIdle) break;
+        host_stack_probe(&probe);
+        AppEvent event = {.type = AppEventTypeRendered};
+        if(app_event_handle(state, &event)) snapshot_publish(state);
+    }
+    host_worker_stack = MAX(host_worker_stack, probe.used);
+}
+
+static void host_input(AppState* state, InputKey key, InputType type) {
+    AppEvent event = {.type = AppEventTypeInput, .input = {.key = key, .type = type}};
+    if(app_event_handle(state, &event)) snapshot_publish(state);
+}
+
+// A tap as the firmware sends it: press, short on the release, release
+static void host_key(AppState* state, InputKey key) {
+    host_input(state, key, InputTypePress);
+    host_input(state, key, InputTypeShort);
+    host_input(state, key, InputTypeRelease);
+}
+
+static void host_key_long(AppState* state, InputKey key) {
+    host_input(state, key, InputTypePress);
+    host_input(state, key, InputTypeLong);
+    host_input(state, key, InputTypeRelease);
+}
+
+static int host_probe_failures;
+
+static void host_expect(bool condition, const char* what, int item) {
+    if(condition) return;
+    fprintf(stderr, "stack probe: %s (%s)\n", what, item >= 0 ? menu_item_names[item] : "-");
+    host_probe_failures++;
+}
+
+// Everything a menu item can change, to see that it did
+static void host_settings(const AppState* state, uint32_t settings[static 10]) {
+    settings[0] = state->render_mode;
+    settings[1] = state->symmetry_group;
+    settings[2] = state->animation_mode;
+    settings[3] = state->animation_fps;
+    settings[4] = state->direct_draw;
+    settings[5] = state->gray_planes;
+    settings[6] = state->smooth_zoom;
+    settings[7] = state->pan_keys;
+    settings[8] = state->random_seed;
+    settings[9] = state->export_format;
+}
+
+static void host_step(AppState* state, Canvas* canvas) {
+    AppEvent tick = {.type = AppEventTypeTick};
+    if(app_event_handle(state, &tick)) snapshot_publish(state);
+    host_worker_drain(state);
+    render_canvas(canvas, state);
+}
+
+/**
+ * Open the mode menu, change every item one way and back, run its OK action (export, new
+ * seed) and check that each of them took effect
+ */
+static void host_menu_walk(AppState* state, Canvas* canvas) {
+    uint32_t before[10];
+    uint32_t after[10];
+    for(int item = 0; item < MenuItemCount; item++) {
+        host_key_long(state, InputKeyBack);
+        host_expect(state->menu_open, "menu did not open", item);
+        while(state->menu_item != (MenuItem)item && state->menu_open) host_key(state, InputKeyDown);
+        host_expect(state->menu_item == (MenuItem)item, "item not reached", item);
+        
+        host_settings(state, before);
+        host_key(state, InputKeyRight);
+        host_settings(state, after);
+        host_expect(memcmp(before, after, sizeof(before)) != 0, "Right changed nothing", item);
+        host_step(state, canvas);
+        
+        if(item == MenuItemExport || item == MenuItemSeed) {
+            uint32_t random_seed = state->random_seed;
+            host_key(state, InputKeyOk);
+            host_step(state, canvas);
+            if(item == MenuItemExport) {
+                host_expect(state->export_result >= 0, "nothing exported", item);
+            } else {
+                host_expect(state->random_seed != random_seed, "seed not replaced", item);
+            }
+        }
+        
+        host_key(state, InputKeyLeft);
+        host_step(state, canvas);
+        host_key(state, InputKeyBack);
+        host_expect(!state->menu_open, "menu did not close", item);
+        host_step(state, canvas);
+    }
+}
+
+/**
+ * What the main loop does, short of waiting for events: the mode menu with every item and its
+ * action, the keys outside the menu, panning, animation ticks, publishing with the info text,
+ * drawing the canvas directly, the render and kernel benchmarks. Writes below ext/ like the app
+ * on the SD card.
+ */
+static void* host_main_work(void* argument) {
+    AppState* state = argument;
+    Canvas* canvas = host_canvas_alloc();
+    static const InputKey keys[] = {InputKeyUp, InputKeyDown, InputKeyLeft, InputKeyRight, InputKeyOk};
+    
+    state->show_info = true;
+    state->animation_mode = AnimationDrift;
+    for(int group = 0; group < SymmetryCount; group++) {
+        for(int a = MIN_SIDE_LENGTH; a <= MAX_SIDE_LENGTH; a += 4 * SIDE_LENGTH_STEP) {
+            state->symmetry_group = group;
+            state->side_length = a;
+            host_worker_drain(state);
+            host_expect(state->orbits.group == (SymmetryGroup)group && state->orbits.side_length == a,
+                        "geometry not rebuilt", -1);
+            host_menu_walk(state, canvas);
+            
+            for(size_t i = 0; i < COUNT_OF(keys); i++) {
+                host_key(state, keys[i]);
+                host_step(state, canvas);
+            }
+            host_key_long(state, InputKeyOk);
+            host_step(state, canvas);
+            
+            state->pan_keys = true;
+            for(size_t i = 0; i < 4; i++) {
+                Point pan = state->pan;
+                host_key(state, keys[i]);
+                host_expect(pan.x != state->pan.x || pan.y != state->pan.y, "no pan", MenuItemArrows);
+                host_step(state, canvas);
+            }
+            state->pan_keys = false;
+            // Back at the size the loop set, the keys above moved it
+            state->side_length = a;
+        }
+    }
+    benchmark_run(state);
+    render_canvas(canvas, state);
+    
+    free(canvas);
+    return NULL;
+}
+
+/**
+ * Build the geometry at every origin within one pan_period() and report the largest one
+ *
+ * @return the number of geometries that did not fit
+ */
+static int host_pan_sweep(AppState* state, int only_side_length, int only_group) {
+    size_t peak = 0;
+    int peak_group = 0;
+    int peak_side_length = 0;
+    Point peak_origin = {0, 0};
+    long builds = 0;
+    int failures = 0;
+    
+    for(int group = 0; group < SymmetryCount; group++) {
+        if(only_group >= 0 && group != only_group) continue;
+        for(int a = MIN_SIDE_LENGTH; a <= MAX_SIDE_LENGTH; a += SIDE_LENGTH_STEP) {
+            if(only_side_length && a != only_side_length) continue;
+            Point period = pan_period(a, group);
+            for(int y = 0; y < period.y; y++) {
+                for(int x = 0; x < period.x; x++) {
+                    Point origin = {x, y};
+                    state->geometry_arena.peak = 0;
+                    if(!geometry_build_into(
+                           &state->lattice, &state->symmetry, &state->orbits, &state->geometry_arena, a, group,
+                           origin)) {
+                        fprintf(stderr, "%s a:%d origin (%d,%d) does not fit\n", symmetry_groups[group].name, a, x,
+                                y);
+                        failures++;
+                    }
+                    if(state->geometry_arena.peak > peak) {
+                        peak = state->geometry_arena.peak;
+                        peak_group = group;
+                        peak_side_length = a;
+                        peak_origin = origin;
+                    }
+                    builds++;
+                }
+            }
+        }
+    }
+    printf("pan sweep: %ld geometries, %d did not fit, peak %zu of %u bytes (%s a:%d origin (%d,%d))\n", builds,
+           failures, peak, (unsigned)GEOMETRY_ARENA_SIZE, symmetry_groups[peak_group].name, peak_side_length,
+           peak_origin.x, peak_origin.y);
+    return failures;
+}
+
+static void host_usage(const char* name) {
+    fprintf(stderr, "Usage: %s [-k|-K] [-s] [-p] [-o DIR] [-n FRAMES] [-a SIDE_LENGTH] [-m lattice|tile|filled]"
+            " [-g GROUP]\n", name);
+    fprintf(stderr, "Groups:");
+    for(int group = 0; group < SymmetryCount; group++) {
+        fprintf(stderr, " %s", symmetry_groups[group].name);
+    }
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char** argv) {
+    const char* out_dir = NULL;
+    int frames = HOST_DEFAULT_FRAMES;
+    int only_side_length = 0;
+    int only_mode = -1;
+    int only_group = -1;
+    bool kernels = false;
+    bool kernels_strict = false;
+    bool stack = false;
+    bool sweep = false;
+    
+    int option;
+    while((option = getopt(argc, argv, "kKspo:n:a:m:g:h")) != -1) {
+        switch(option) {
+            case 'k':
+                kernels = true;
+                break;
+            case 'K':
+                kernels = true;
+                kernels_strict = true;
+                break;
+            case 's':
+                stack = true;
+                break;
+            case 'p':
+                sweep = true;
+                break;
+            case 'o':
+                out_dir = optarg;
+                break;
+            case 'n':
+                frames = CLAMP(atoi(optarg), HOST_MAX_FRAMES, 1);
+                break;
+            case 'a':
+                only_side_length = atoi(optarg);
+                break;
+            case 'm':
+                for(int mode = 0; mode < RenderModeCount; mode++) {
+                    if(strcmp(optarg, render_mode_names[mode]) == 0) only_mode = mode;
+                }
+                if(only_mode < 0) {
+                    host_usage(argv[0]);
+                    return 2;
+                }
+                break;
+            case 'g':
+                for(int group = 0; group < SymmetryCount; group++) {
+                    if(strcmp(optarg, symmetry_groups[group].name) == 0) only_group = group;
+                }
+                if(only_group < 0) {
+                    host_usage(argv[0]);
+                    return 2;
+                }
+                break;
+            default:
+                host_usage(argv[0]);
+                return 2;
+        }
+    }
+    
+    AppState* state = calloc(1, sizeof(AppState));
+    Canvas* canvas = host_canvas_alloc();
+    if(state == NULL || canvas == NULL) return 1;
+    state->gray_planes = 1;
+    static uint8_t geometry_region[GEOMETRY_ARENA_SIZE];
+    static uint8_t worker_region[GEOMETRY_ARENA_SIZE];
+    arena_init(&state->geometry_arena, geometry_region, sizeof(geometry_region));
+    arena_init(&state->worker.arena, worker_region, sizeof(worker_region));
+    
+    if(stack) {
+        state->side_length = MAX_SIDE_LENGTH;
+        state->seed_count = DEFAULT_SEED_COUNT;
+        state->animation_fps = 10;
+        state->worker.work = RenderWorkIdle;
+        bool done = geometry_build(state);
+        if(done) {
+            seeds_regenerate(state);
+            pattern_render(state);
+            // Like the app at startup, exports go to the next free numbers and are removed after
+            export_next_find(state);
+            int export_first = state->export_next;
+            char sink;
+            HostProbe base = {host_probe_empty, NULL, 0};
+            HostProbe format = {host_format, &sink, 0};
+            HostProbe probe = {host_main_work, state, 0};
+            host_log_quiet = true;
+            done = host_stack_probe(&base) && host_stack_probe(&format) && host_stack_probe(&probe) &&
+                   host_probe_failures == 0;
+            host_log_quiet = false;
+            for(int number = export_first; number < state->export_next; number++) {
+                for(int format = 0; format < ExportFormatCount; format++) {
+                    char path[64];
+                    export_path(path, sizeof(path), number, format);
+                    storage_common_remove(NULL, path);
+                }
+            }
+            printf("stack: render worker %zu bytes, main loop work %zu bytes of which %zu in one snprintf"
+                   " (host frames)\n",
+                   host_worker_stack, probe.used, format.used);
+        }
+        free(canvas);
+        free(state);
+        return done ? 0 : 1;
+    }
+    
+    if(sweep) {
+        int failures = host_pan_sweep(state, only_side_length, only_group);
+        free(canvas);
+        free(state);
+        return failures ? 1 : 0;
+    }
+    
+    if(kernels) {
+        bool done = kernel_benchmark_run(state);
+        const BenchmarkReport* report = &state->benchmark;
+        if(done) {
+            printf("%d kernel results in %s, %d over +%d%%%s\n", report->kernel_results, KERNELS_PATH + 1,
+                   report->kernel_regressions, KERNEL_REGRESSION_PERCENT,
+                   report->kernel_baseline_saved ? ", saved as baseline" : "");
+        } else {
+            fprintf(stderr, "kernel benchmark failed\n");
+        }
+        int regressions = report->kernel_regressions;
+        free(canvas);
+        free(state);
+        return (done && !(kernels_strict && regressions > 0)) ? 0 : 1;
+    }
+    
+    static uint64_t samples[HOST_MAX_FRAMES];
+    uint64_t total_ns = 0;
+    int failures = 0;
+    
+    printf("group mode     a  lines centers   min_us   med_us   max_us\n");
+    for(int group = 0; group < SymmetryCount; group++) {
+        if(only_group >= 0 && group != only_group) continue;
+        
+        for(int mode = 0; mode < RenderModeCount; mode++) {
+            if(only_mode >= 0 && mode != only_mode) continue;
+            
+            for(int a = MIN_SIDE_LENGTH; a <= MAX_SIDE_LENGTH; a += SIDE_LENGTH_STEP) {
+                if(only_side_length && a != only_side_length) continue;
+                
+                state->side_length = a;
+                state->render_mode = mode;
+                state->symmetry_group = group;
+                if(!geometry_build(state)) {
+                    fprintf(stderr, "%s a=%d: geometry build failed\n", symmetry_groups[group].name, a);
+                    failures++;
+                    continue;
+                }
+                
+                // Same seeds for every run, independent of -a, -m and -g
+                state->random_seed = (uint32_t)a;
+                state->seed_count = DEFAULT_SEED_COUNT;
+                seeds_regenerate(state);
+                
+                for(int config = 0; config < 4; config++) {
+                    state->show_lines = (config & 1) != 0;
+                    state->show_info = (config & 2) != 0;
+                    
+                    for(int i = 0; i < frames; i++) {
+                        uint64_t start = host_now_ns();
+                        draw_pattern(state->frame, state);
+                        samples[i] = host_now_ns() - start;
+                        total_ns += samples[i];
+                    }
+                    qsort(samples, frames, sizeof(samples[0]), host_compare_u64);
+                    printf("%-5s %-7s %2d  %5d %7d %8.2f %8.2f %8.2f\n", symmetry_groups[group].name,
+                           render_mode_names[mode], a, state->show_lines, state->show_info,
+                           samples[0] / 1000.0, samples[frames / 2] / 1000.0,
+                           samples[frames - 1] / 1000.0);
+                    
+                    if(out_dir) {
+                        char path[256];
+                        snprintf(path, sizeof(path), "%s/%s_%s_a%02d_l%d_c%d.pbm", out_dir,
+                                 symmetry_groups[group].name, render_mode_names[mode], a,
+                                 state->show_lines, state->show_info);
+                        if(!host_write_pbm(path, state->frame)) {
+                            fprintf(stderr, "%s: write failed\n", path);
+                            failures++;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    printf("total %.3f ms\n", total_ns / 1000000.0);
+    printf("geometry peak %u of %u bytes\n", (unsigned)state->geometry_arena.peak, (unsigned)GEOMETRY_ARENA_SIZE);
+    
+    free(canvas);
+    free(state);
+    return failures ? 1 : 0;
+}
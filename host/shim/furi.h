@@ -0,0 +1,98 @@
+// Minimal furi API for the host build, only what karl-eido.c uses
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UNUSED(x) (void)(x)
+#define furi_assert(x) ((void)(x))
+#define furi_check(x) ((void)(x))
+#define FuriWaitForever 0xFFFFFFFFU
+
+#define FURI_LOG_I(tag, format, ...) host_log("I", tag, format, ##__VA_ARGS__)
+#define FURI_LOG_D(tag, format, ...) host_log("D", tag, format, ##__VA_ARGS__)
+#define FURI_LOG_W(tag, format, ...) host_log("W", tag, format, ##__VA_ARGS__)
+#define FURI_LOG_E(tag, format, ...) host_log("E", tag, format, ##__VA_ARGS__)
+
+#ifndef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+#define CLAMP(x, upper, lower) (MIN(upper, MAX(x, lower)))
+#define COUNT_OF(x) (sizeof(x) / sizeof(x[0]))
+
+void host_log(const char* level, const char* tag, const char* format, ...)
+    __attribute__((format(printf, 3, 4)));
+extern bool host_log_quiet; // Drop the log lines, the stack probe would measure glibc's printf
+
+typedef enum {
+    FuriStatusOk = 0,
+    FuriStatusError = -1,
+    FuriStatusErrorTimeout = -2,
+    FuriStatusErrorResource = -3,
+} FuriStatus;
+
+typedef struct FuriMessageQueue FuriMessageQueue;
+FuriMessageQueue* furi_message_queue_alloc(uint32_t msg_count, uint32_t msg_size);
+void furi_message_queue_free(FuriMessageQueue* instance);
+FuriStatus furi_message_queue_put(FuriMessageQueue* instance, const void* msg_ptr, uint32_t timeout);
+FuriStatus furi_message_queue_get(FuriMessageQueue* instance, void* msg_ptr, uint32_t timeout);
+
+typedef enum {
+    FuriTimerTypeOnce = 0,
+    FuriTimerTypePeriodic = 1,
+} FuriTimerType;
+typedef void (*FuriTimerCallback)(void* context);
+typedef struct FuriTimer FuriTimer;
+FuriTimer* furi_timer_alloc(FuriTimerCallback func, FuriTimerType type, void* context);
+void furi_timer_free(FuriTimer* instance);
+FuriStatus furi_timer_start(FuriTimer* instance, uint32_t ticks);
+FuriStatus furi_timer_stop(FuriTimer* instance);
+uint32_t furi_timer_is_running(FuriTimer* instance);
+
+typedef enum {
+    FuriFlagWaitAny = 0x00000000U,
+    FuriFlagError = 0x80000000U,
+} FuriFlag;
+
+typedef enum {
+    FuriThreadPriorityLow = 2,
+} FuriThreadPriority;
+typedef int32_t (*FuriThreadCallback)(void* context);
+typedef struct FuriThread FuriThread;
+typedef void* FuriThreadId;
+FuriThread* furi_thread_alloc_ex(const char* name, uint32_t stack_size, FuriThreadCallback callback, void* context);
+void furi_thread_free(FuriThread* thread);
+void furi_thread_set_priority(FuriThread* thread, FuriThreadPriority priority);
+void furi_thread_start(FuriThread* thread);
+bool furi_thread_join(FuriThread* thread);
+FuriThreadId furi_thread_get_id(FuriThread* thread);
+uint32_t furi_thread_flags_set(FuriThreadId thread_id, uint32_t flags);
+uint32_t furi_thread_flags_get(void);
+uint32_t furi_thread_flags_wait(uint32_t flags, uint32_t options, uint32_t timeout);
+FuriThreadId furi_thread_get_current_id(void);
+uint32_t furi_thread_get_stack_space(FuriThreadId thread_id);
+
+size_t memmgr_get_minimum_free_heap(void);
+
+uint32_t furi_get_tick(void);
+void furi_delay_ms(uint32_t milliseconds);
+uint32_t furi_kernel_get_tick_frequency(void);
+uint32_t furi_ms_to_ticks(uint32_t milliseconds);
+
+typedef struct FuriPubSub FuriPubSub;
+typedef struct FuriPubSubSubscription FuriPubSubSubscription;
+typedef void (*FuriPubSubCallback)(const void* message, void* context);
+FuriPubSubSubscription* furi_pubsub_subscribe(FuriPubSub* pubsub, FuriPubSubCallback callback, void* context);
+void furi_pubsub_unsubscribe(FuriPubSub* pubsub, FuriPubSubSubscription* subscription);
+
+void* furi_record_open(const char* name);
+void furi_record_close(const char* name);
+
+#include <furi_hal.h>
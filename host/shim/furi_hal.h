@@ -0,0 +1,22 @@
+// Minimal furi_hal API for the host build
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+uint32_t furi_hal_random_get(void);
+
+// Cycle counter stand-in: every access reads the monotonic clock and counts
+// furi_hal_cortex_instructions_per_microsecond() cycles per microsecond, like the device at 64 MHz
+typedef struct {
+    uint32_t CYCCNT;
+} HostDwt;
+HostDwt* host_dwt_read(void);
+#define DWT (host_dwt_read())
+uint32_t furi_hal_cortex_instructions_per_microsecond(void);
+
+typedef struct {
+    int pin;
+} GpioPin;
+extern const GpioPin gpio_button_back;
+bool furi_hal_gpio_read(const GpioPin* gpio);
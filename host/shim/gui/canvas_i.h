@@ -0,0 +1,6 @@
+// Minimal canvas internals for the host build
+#pragma once
+
+#include <gui/gui.h>
+
+uint8_t* canvas_get_buffer(Canvas* canvas);
@@ -0,0 +1,55 @@
+// Minimal gui API for the host build: a Canvas is a 128x64 frame in the display layout
+#pragma once
+
+#include <furi.h>
+#include <input/input.h>
+
+typedef struct Canvas Canvas;
+
+typedef enum {
+    ColorWhite = 0,
+    ColorBlack = 1,
+    ColorXOR = 2,
+} Color;
+
+typedef enum {
+    AlignLeft,
+    AlignRight,
+    AlignTop,
+    AlignBottom,
+    AlignCenter,
+} Align;
+
+void canvas_reset(Canvas* canvas);
+void canvas_commit(Canvas* canvas);
+void canvas_set_color(Canvas* canvas, Color color);
+void canvas_draw_box(Canvas* canvas, int32_t x, int32_t y, size_t width, size_t height);
+void canvas_draw_str(Canvas* canvas, int32_t x, int32_t y, const char* str);
+void canvas_draw_str_aligned(
+    Canvas* canvas,
+    int32_t x,
+    int32_t y,
+    Align horizontal,
+    Align vertical,
+    const char* str);
+
+typedef struct ViewPort ViewPort;
+typedef void (*ViewPortDrawCallback)(Canvas* canvas, void* context);
+typedef void (*ViewPortInputCallback)(InputEvent* event, void* context);
+ViewPort* view_port_alloc(void);
+void view_port_free(ViewPort* view_port);
+void view_port_draw_callback_set(ViewPort* view_port, ViewPortDrawCallback callback, void* context);
+void view_port_input_callback_set(ViewPort* view_port, ViewPortInputCallback callback, void* context);
+void view_port_update(ViewPort* view_port);
+
+typedef struct Gui Gui;
+#define RECORD_GUI "gui"
+
+typedef enum {
+    GuiLayerFullscreen,
+} GuiLayer;
+
+void gui_add_view_port(Gui* gui, ViewPort* view_port, GuiLayer layer);
+void gui_remove_view_port(Gui* gui, ViewPort* view_port);
+Canvas* gui_direct_draw_acquire(Gui* gui);
+void gui_direct_draw_release(Gui* gui);
@@ -0,0 +1,431 @@
+// Host implementations of the shim API: a memory canvas and inert system services
+
+#include <furi.h>
+#include <errno.h>
+#include <gui/canvas_i.h>
+#include <stdarg.h>
+#include <storage/storage.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#define CANVAS_WIDTH 128
+#define CANVAS_HEIGHT 64
+
+struct Canvas {
+    uint8_t buffer[CANVAS_WIDTH * CANVAS_HEIGHT / 8];
+    Color color;
+};
+
+static HostDwt host_dwt;
+const GpioPin gpio_button_back = {0};
+
+static uint32_t random_state = 1;
+
+Canvas* host_canvas_alloc(void) {
+    Canvas* canvas = calloc(1, sizeof(Canvas));
+    if(canvas) canvas->color = ColorBlack;
+    return canvas;
+}
+
+bool host_log_quiet;
+
+void host_log(const char* level, const char* tag, const char* format, ...) {
+    if(host_log_quiet) return;
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "[%s][%s] ", level, tag);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+// xorshift32, the app seeds its own generator from this once at startup
+uint32_t furi_hal_random_get(void) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+uint32_t furi_hal_cortex_instructions_per_microsecond(void) {
+    return 64;
+}
+
+HostDwt* host_dwt_read(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t ns = (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+    host_dwt.CYCCNT = (uint32_t)(ns * furi_hal_cortex_instructions_per_microsecond() / 1000u);
+    return &host_dwt;
+}
+
+bool furi_hal_gpio_read(const GpioPin* gpio) {
+    UNUSED(gpio);
+    return true; // Buttons are active low: nothing is pressed
+}
+
+uint32_t furi_get_tick(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+}
+
+void furi_delay_ms(uint32_t milliseconds) {
+    struct timespec delay = {milliseconds / 1000, (long)(milliseconds % 1000) * 1000000};
+    nanosleep(&delay, NULL);
+}
+
+uint32_t furi_kernel_get_tick_frequency(void) {
+    return 1000;
+}
+
+uint32_t furi_ms_to_ticks(uint32_t milliseconds) {
+    return milliseconds;
+}
+
+static void canvas_set_pixel(Canvas* canvas, int32_t x, int32_t y) {
+    if(x < 0 || y < 0 || x >= CANVAS_WIDTH || y >= CANVAS_HEIGHT) return;
+    uint8_t* byte = &canvas->buffer[(y / 8) * CANVAS_WIDTH + x];
+    uint8_t mask = (uint8_t)(1 << (y % 8));
+    if(canvas->color == ColorBlack) {
+        *byte |= mask;
+    } else if(canvas->color == ColorWhite) {
+        *byte &= (uint8_t)~mask;
+    } else {
+        *byte ^= mask;
+    }
+}
+
+void canvas_reset(Canvas* canvas) {
+    memset(canvas->buffer, 0, sizeof(canvas->buffer));
+    canvas->color = ColorBlack;
+}
+
+void canvas_commit(Canvas* canvas) {
+    UNUSED(canvas);
+}
+
+void canvas_set_color(Canvas* canvas, Color color) {
+    canvas->color = color;
+}
+
+void canvas_draw_box(Canvas* canvas, int32_t x, int32_t y, size_t width, size_t height) {
+    for(int32_t dy = 0; dy < (int32_t)height; dy++) {
+        for(int32_t dx = 0; dx < (int32_t)width; dx++) {
+            canvas_set_pixel(canvas, x + dx, y + dy);
+        }
+    }
+}
+
+// There is no font on the host, overlay text only shows up as its background box
+void canvas_draw_str(Canvas* canvas, int32_t x, int32_t y, const char* str) {
+    UNUSED(canvas);
+    UNUSED(x);
+    UNUSED(y);
+    UNUSED(str);
+}
+
+void canvas_draw_str_aligned(
+    Canvas* canvas,
+    int32_t x,
+    int32_t y,
+    Align horizontal,
+    Align vertical,
+    const char* str) {
+    UNUSED(horizontal);
+    UNUSED(vertical);
+    canvas_draw_str(canvas, x, y, str);
+}
+
+uint8_t* canvas_get_buffer(Canvas* canvas) {
+    return canvas->buffer;
+}
+
+// The services below are only reached through karl_main(), which the host never calls
+
+FuriMessageQueue* furi_message_queue_alloc(uint32_t msg_count, uint32_t msg_size) {
+    UNUSED(msg_count);
+    UNUSED(msg_size);
+    return NULL;
+}
+
+void furi_message_queue_free(FuriMessageQueue* instance) {
+    UNUSED(instance);
+}
+
+FuriStatus furi_message_queue_put(FuriMessageQueue* instance, const void* msg_ptr, uint32_t timeout) {
+    UNUSED(instance);
+    UNUSED(msg_ptr);
+    UNUSED(timeout);
+    return FuriStatusErrorResource;
+}
+
+FuriStatus furi_message_queue_get(FuriMessageQueue* instance, void* msg_ptr, uint32_t timeout) {
+    UNUSED(instance);
+    UNUSED(msg_ptr);
+    UNUSED(timeout);
+    return FuriStatusErrorTimeout;
+}
+
+FuriTimer* furi_timer_alloc(FuriTimerCallback func, FuriTimerType type, void* context) {
+    UNUSED(func);
+    UNUSED(type);
+    UNUSED(context);
+    return NULL;
+}
+
+void furi_timer_free(FuriTimer* instance) {
+    UNUSED(instance);
+}
+
+FuriStatus furi_timer_start(FuriTimer* instance, uint32_t ticks) {
+    UNUSED(instance);
+    UNUSED(ticks);
+    return FuriStatusOk;
+}
+
+FuriStatus furi_timer_stop(FuriTimer* instance) {
+    UNUSED(instance);
+    return FuriStatusOk;
+}
+
+uint32_t furi_timer_is_running(FuriTimer* instance) {
+    UNUSED(instance);
+    return 0;
+}
+
+// Threads never run on the host, the app renders synchronously there
+
+FuriThread* furi_thread_alloc_ex(const char* name, uint32_t stack_size, FuriThreadCallback callback, void* context) {
+    UNUSED(name);
+    UNUSED(stack_size);
+    UNUSED(callback);
+    UNUSED(context);
+    return NULL;
+}
+
+void furi_thread_free(FuriThread* thread) {
+    UNUSED(thread);
+}
+
+void furi_thread_set_priority(FuriThread* thread, FuriThreadPriority priority) {
+    UNUSED(thread);
+    UNUSED(priority);
+}
+
+void furi_thread_start(FuriThread* thread) {
+    UNUSED(thread);
+}
+
+bool furi_thread_join(FuriThread* thread) {
+    UNUSED(thread);
+    return true;
+}
+
+FuriThreadId furi_thread_get_id(FuriThread* thread) {
+    UNUSED(thread);
+    return NULL;
+}
+
+uint32_t furi_thread_flags_set(FuriThreadId thread_id, uint32_t flags) {
+    UNUSED(thread_id);
+    return flags;
+}
+
+uint32_t furi_thread_flags_get(void) {
+    return 0;
+}
+
+uint32_t furi_thread_flags_wait(uint32_t flags, uint32_t options, uint32_t timeout) {
+    UNUSED(flags);
+    UNUSED(options);
+    UNUSED(timeout);
+    return FuriFlagError;
+}
+
+FuriThreadId furi_thread_get_current_id(void) {
+    return NULL;
+}
+
+uint32_t furi_thread_get_stack_space(FuriThreadId thread_id) {
+    UNUSED(thread_id);
+    return 0;
+}
+
+size_t memmgr_get_minimum_free_heap(void) {
+    return 0;
+}
+
+FuriPubSubSubscription* furi_pubsub_subscribe(FuriPubSub* pubsub, FuriPubSubCallback callback, void* context) {
+    UNUSED(pubsub);
+    UNUSED(callback);
+    UNUSED(context);
+    return NULL;
+}
+
+void furi_pubsub_unsubscribe(FuriPubSub* pubsub, FuriPubSubSubscription* subscription) {
+    UNUSED(pubsub);
+    UNUSED(subscription);
+}
+
+void* furi_record_open(const char* name) {
+    UNUSED(name);
+    return NULL;
+}
+
+void furi_record_close(const char* name) {
+    UNUSED(name);
+}
+
+ViewPort* view_port_alloc(void) {
+    return NULL;
+}
+
+void view_port_free(ViewPort* view_port) {
+    UNUSED(view_port);
+}
+
+void view_port_draw_callback_set(ViewPort* view_port, ViewPortDrawCallback callback, void* context) {
+    UNUSED(view_port);
+    UNUSED(callback);
+    UNUSED(context);
+}
+
+void view_port_input_callback_set(ViewPort* view_port, ViewPortInputCallback callback, void* context) {
+    UNUSED(view_port);
+    UNUSED(callback);
+    UNUSED(context);
+}
+
+void view_port_update(ViewPort* view_port) {
+    UNUSED(view_port);
+}
+
+void gui_add_view_port(Gui* gui, ViewPort* view_port, GuiLayer layer) {
+    UNUSED(gui);
+    UNUSED(view_port);
+    UNUSED(layer);
+}
+
+void gui_remove_view_port(Gui* gui, ViewPort* view_port) {
+    UNUSED(gui);
+    UNUSED(view_port);
+}
+
+Canvas* gui_direct_draw_acquire(Gui* gui) {
+    UNUSED(gui);
+    return NULL;
+}
+
+void gui_direct_draw_release(Gui* gui) {
+    UNUSED(gui);
+}
+
+// Storage on top of stdio, paths lose their leading slash
+
+struct File {
+    FILE* stream;
+};
+
+static const char* host_path(const char* path) {
+    return (path[0] == '/') ? path + 1 : path;
+}
+
+File* storage_file_alloc(Storage* storage) {
+    UNUSED(storage);
+    return calloc(1, sizeof(File));
+}
+
+void storage_file_free(File* file) {
+    if(file && file->stream) fclose(file->stream);
+    free(file);
+}
+
+bool storage_file_open(File* file, const char* path, FS_AccessMode access_mode, FS_OpenMode open_mode) {
+    const char* mode = "rb";
+    if(access_mode & FSAM_WRITE) {
+        mode = (open_mode & FSOM_CREATE_ALWAYS) ? "wb" : (open_mode & FSOM_CREATE_NEW) ? "wbx" : "r+b";
+    }
+    file->stream = fopen(host_path(path), mode);
+    return file->stream != NULL;
+}
+
+bool storage_file_close(File* file) {
+    bool closed = file->stream && fclose(file->stream) == 0;
+    file->stream = NULL;
+    return closed;
+}
+
+size_t storage_file_read(File* file, void* buff, size_t bytes_to_read) {
+    return file->stream ? fread(buff, 1, bytes_to_read, file->stream) : 0;
+}
+
+size_t storage_file_write(File* file, const void* buff, size_t bytes_to_write) {
+    return file->stream ? fwrite(buff, 1, bytes_to_write, file->stream) : 0;
+}
+
+FS_Error storage_common_stat(Storage* storage, const char* path, FileInfo* fileinfo) {
+    UNUSED(storage);
+    UNUSED(fileinfo);
+    struct stat info;
+    return stat(host_path(path), &info) == 0 ? FSE_OK : FSE_NOT_EXIST;
+}
+
+FS_Error storage_common_remove(Storage* storage, const char* path) {
+    UNUSED(storage);
+    return remove(host_path(path)) == 0 ? FSE_OK : FSE_NOT_EXIST;
+}
+
+FS_Error storage_common_rename(Storage* storage, const char* old_path, const char* new_path) {
+    UNUSED(storage);
+    return rename(host_path(old_path), host_path(new_path)) == 0 ? FSE_OK : FSE_INTERNAL;
+}
+
+bool storage_simply_mkdir(Storage* storage, const char* path) {
+    UNUSED(storage);
+    char directory[256];
+    snprintf(directory, sizeof(directory), "%s", host_path(path));
+    for(char* slash = strchr(directory, '/'); slash; slash = strchr(slash + 1, '/')) {
+        *slash = '\0';
+        mkdir(directory, 0755);
+        *slash = '/';
+    }
+    return mkdir(directory, 0755) == 0 || errno == EEXIST;
+}
+
+// saved_struct with the firmware's header: magic, version, checksum, flags, timestamp
+
+typedef struct {
+    uint8_t magic;
+    uint8_t version;
+    uint8_t checksum;
+    uint8_t flags;
+    uint32_t timestamp;
+} SavedStructHeader;
+
+static uint8_t saved_struct_checksum(const void* data, size_t size) {
+    uint8_t checksum = 0;
+    for(size_t i = 0; i < size; i++) checksum += ((const uint8_t*)data)[i];
+    return checksum;
+}
+
+bool saved_struct_load(const char* path, void* data, size_t size, uint8_t magic, uint8_t version) {
+    FILE* stream = fopen(host_path(path), "rb");
+    if(stream == NULL) return false;
+    
+    SavedStructHeader header;
+    bool loaded = fread(&header, sizeof(header), 1, stream) == 1 && fread(data, size, 1, stream) == 1 &&
+                  header.magic == magic && header.version == version &&
+                  header.checksum == saved_struct_checksum(data, size);
+    fclose(stream);
+    return loaded;
+}
+
+bool saved_struct_save(const char* path, const void* data, size_t size, uint8_t magic, uint8_t version) {
+    FILE* stream = fopen(host_path(path), "wb");
+    if(stream == NULL) return false;
+    
+    SavedStructHeader header = {magic, version, saved_struct_checksum(data, size), 0, 0};
+    bool saved = fwrite(&header, sizeof(header), 1, stream) == 1 && fwrite(data, size, 1, stream) == 1;
+    return fclose(stream) == 0 && saved;
+}
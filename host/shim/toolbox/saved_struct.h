@@ -0,0 +1,7 @@
+// Minimal saved_struct API for the host build
+#pragma once
+
+#include <furi.h>
+
+bool saved_struct_load(const char* path, void* data, size_t size, uint8_t magic, uint8_t version);
+bool saved_struct_save(const char* path, const void* data, size_t size, uint8_t magic, uint8_t version);
@@ -1,279 +1,4173 @@
 /**
  * Karl Eido's Scope 
- * - Up/Down: Adjust triangle size (5-63px in 2px steps)
- * - OK (short press): Toggle debug info and center points
+ * - Up/Down: Adjust triangle size (5-63px in 2px steps, or continuously while held with smooth zoom)
+ * - Left/Right: Remove/add a random pixel in the fundamental domain, mirrored into every image
+ * - OK (short press): Toggle debug info and center points (with KARL_EIDO_PROFILE: off, info, profile)
  * - OK (long press): Toggle line display
- * - Back: Exit app
+ * - Back (long press): Open the mode menu (Up/Down: item, Left/Right: value, Back: close)
+ * - Back (short press): Exit app
+ * - Back held while the app starts: Run the render benchmark
  */
 
 #include <furi.h>
+#include <furi_hal.h>
 #include <gui/gui.h>
+#include <gui/canvas_i.h>
 #include <input/input.h>
+#include <storage/storage.h>
+#include <toolbox/saved_struct.h>
+#include <inttypes.h>
+#include <stdatomic.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include "lattice_tables.h"
+
+#define TAG "KarlEido"
 
 // Screen dimensions
 #define SCREEN_WIDTH 128
 #define SCREEN_HEIGHT 64
 
 // Triangle size constraints
-#define MIN_SIDE_LENGTH 10
+#define MIN_SIDE_LENGTH 5
 #define MAX_SIDE_LENGTH 63
 #define SIDE_LENGTH_STEP 2
 #define CENTER_Y 31
 
+#if LATTICE_TABLE_MIN_SIDE_LENGTH != MIN_SIDE_LENGTH || LATTICE_TABLE_MAX_SIDE_LENGTH != MAX_SIDE_LENGTH || \
+    LATTICE_TABLE_SIDE_LENGTH_STEP != SIDE_LENGTH_STEP
+#error "lattice_tables.h is out of date, run tools/gen_lattice_tables.py"
+#endif
+
+// Column widths in Q16.16 fixed point, the tables accumulate them the same way
+#define FIXED_SHIFT 16
+#define SQRT3_HALF_Q16 56756 // sqrt(3)/2
+
+// 1bpp frame in the display's native layout: byte (y / 8) * SCREEN_WIDTH + x holds bit y % 8
+#define FRAME_PAGES (SCREEN_HEIGHT / 8)
+#define FRAME_SIZE (SCREEN_WIDTH * FRAME_PAGES)
+
+// Random pixels in the base triangle
+#define MAX_SEEDS 64
+#define DEFAULT_SEED_COUNT 8
+
+// Animation pacing
+#define DEFAULT_ANIMATION_FPS 20
+#define MIN_ANIMATION_FPS 5
+#define MAX_ANIMATION_FPS 30
+#define ANIMATION_FPS_STEP 5
+#define ANIMATION_STALL_MS 1000 // Give up waiting for a frame that was never drawn
+
+// Smooth zoom: side length change per second while Up/Down are held, and the slope of the
+// lattice diagonals (1/sqrt(3)) in Q16.16
+#define ZOOM_SPEED 12
+#define DIAGONAL_SLOPE_Q16 37837
+
+// Panning: pixels per second while a pan key is held or the pattern scrolls
+#define PAN_SPEED 40
+
+// Temporal dithering: bitplanes shown in turn, the display blends them into gray levels
+#define GRAY_MAX_PLANES 3
+#define GRAY_FLIP_MS 16 // One plane per flip, about 60 planes per second
+
+// Memory: one block allocated at startup holds the state and two geometry regions (lattice
+// cache and orbit table), front and back. The render worker builds into the back region, the
+// two swap when the new geometry is taken over; nothing is allocated afterwards. The worst
+// geometry over all side lengths, groups and pan origins is 43920 bytes (p3m1, a=5, origin
+// (1,14)); `make -C host sweep` builds all of them and fails if one does not fit.
+#define GEOMETRY_ARENA_SIZE (45 * 1024)
+#define ARENA_ALIGNMENT 8
+#define ARENA_ALIGN(size) (((size) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+// Render worker thread: `make -C host stack` measures 800 bytes at the deepest job over every
+// group and menu action (host frames, geometry_build_into -> orbit_table_build), plus half of
+// that again and room for the context and FPU registers an interrupt pushes
+#define RENDER_WORKER_STACK_SIZE 1536
+#define RENDER_WORKER_POST_MS 50 // Retry interval while the event queue is full
+
+// Seed motion in Q8 fixed point: drift speed limit and rotation step (6 degrees, Q30, which
+// keeps the radius within 1e-9 of its length per step, so rotating seeds do not spiral in)
+#define MOTION_SHIFT 8
+#define MAX_DRIFT_SPEED 96
+#define ROTATION_SHIFT 30
+#define ROTATION_COS_Q30 1067859754LL
+#define ROTATION_SIN_Q30 112236583LL
+
+// Exports and settings, spelled out because the appid is "karl_edio"
+#define DATA_DIRECTORY EXT_PATH("apps_data/karl_eido")
+
+// Settings restored at startup
+#define SETTINGS_PATH DATA_DIRECTORY "/settings.bin"
+#define SETTINGS_MAGIC 0x4B
+#define SETTINGS_VERSION 4
+
+// Pattern export: the header is "P4\n128 64\n", RLE needs one extra byte per 128 raster bytes
+#define EXPORT_MAX_FILES 1000
+#define EXPORT_HEADER_SIZE 16
+#define EXPORT_RLE_SLACK (FRAME_SIZE / 128 + 1)
+#define EXPORT_BUFFER_SIZE (EXPORT_HEADER_SIZE + EXPORT_RLE_SLACK + FRAME_SIZE)
+#define EXPORT_NONE -1
+#define EXPORT_FAILED -2
+#define EXPORT_BUSY -3
+#define EXPORT_RETRIES 8
+
+// Launch to the first frame on the display should take less than one refresh (about 60 Hz);
+// the main loop waits up to STARTUP_WAIT_MS for the GUI thread to draw it
+#define STARTUP_BUDGET_US (1000000 / 60)
+#define STARTUP_WAIT_MS 200
+
+// Depth of the event queue, drained in one batch per frame
+#define EVENT_QUEUE_SIZE 16
+
+// Window over which the idle statistic of the main loop is averaged
+#define IDLE_WINDOW_MS 2000
+
+// Frames timed per benchmark configuration, all runs place the same seeds
+#define BENCHMARK_FRAMES 16
+#define BENCHMARK_RANDOM_SEED 0x4B41524CU
+
+// Kernel benchmark: fastest of KERNEL_RUNS samples in each of KERNEL_PASSES passes over all side
+// lengths, in 1/KERNEL_CYCLE_SCALE cycles per run; a sample repeats the kernel for at least
+// KERNEL_SAMPLE_CYCLES. Interrupts and preemption only ever add time, so the minimum is the
+// stable number, and the passes keep one long disturbance from hitting all samples of a kernel.
+// Results more than KERNEL_REGRESSION_PERCENT and KERNEL_NOISE_CYCLES above the baseline count
+// as regressions
+#define KERNEL_RUNS 15
+#define KERNEL_PASSES 3
+#define KERNEL_SAMPLE_CYCLES 50000
+#define KERNEL_CYCLE_SCALE 100
+#define KERNEL_REGRESSION_PERCENT 10
+#define KERNEL_NOISE_CYCLES 8
+#define KERNELS_PATH DATA_DIRECTORY "/kernels.csv"
+#define KERNEL_BASELINE_PATH DATA_DIRECTORY "/kernels.bin"
+#define KERNEL_BASELINE_MAGIC 0x4B
+#define KERNEL_BASELINE_VERSION 2
+
+// Profiling: the rolling average of every stage follows new values with weight 1/2^PROFILE_AVERAGE_SHIFT
+#define PROFILE_AVERAGE_SHIFT 3
+
+// Telemetry: bucket 0 holds samples below 2^TELEMETRY_MIN_SHIFT us, every further bucket
+// doubles the bound, the last one takes everything above 2^(TELEMETRY_MIN_SHIFT + 14) us (2 s)
+#define TELEMETRY_BUCKETS 16
+#define TELEMETRY_MIN_SHIFT 7
+#define TELEMETRY_DUMP_MS 60000
+#define TELEMETRY_LINE_SIZE 160
+
+// Info overlay text, formatted by the main loop
+#define INFO_LINES 3
+#define INFO_LINE_SIZE 48
+
+// Pixel columns of the widest fundamental domain (the p2mm rectangle) at MAX_SIDE_LENGTH
+#define MAX_BASE_COLUMNS (MAX_SIDE_LENGTH + 2)
+// Largest fundamental domain in pixels: p2mm at MAX_SIDE_LENGTH has 1953
+#define MAX_BASE_PIXELS 2048
+#define SEED_BITMAP_WORDS (MAX_BASE_PIXELS / 32)
+
+// Symmetry points are kept in 1/6 pixels, exact for edge midpoints and centroids
+#define DOMAIN_SCALE 6
+#define MAX_DOMAIN_VERTICES 4
+
+// Longest diagonal run (one column) and distinct diagonal shapes per side length
+#define MAX_DIAGONAL_RUN (((MAX_SIDE_LENGTH * SQRT3_HALF_Q16) >> FIXED_SHIFT) + 2)
+#define MAX_DIAGONAL_PATTERNS 4
+#define NO_DIAGONAL_PATTERN 0xFF
+
+// Widest repeating cell: the p2mm cell at MAX_SIDE_LENGTH, wider than two lattice columns
+#define MAX_TILE_WIDTH (2 * (MAX_SIDE_LENGTH + 1))
+
 // Point structure for coordinates
 typedef struct {
     int x;
     int y;
 } Point;
 
+// Bump allocator over a fixed block, memory is only given back all at once by arena_reset()
+typedef struct {
+    uint8_t* base;
+    size_t size;
+    size_t used;
+    size_t peak; // Highest use since arena_init()
+} Arena;
+
+// Compact point used for cached geometry (coordinates may lie off-screen)
+typedef struct {
+    int16_t x;
+    int16_t y;
+} PackedPoint;
+
+// Cached diagonal edge, from its left to its right end point
+typedef struct {
+    PackedPoint from;
+    PackedPoint to;
+    uint8_t pattern; // Index into LatticeCache.patterns, NO_DIAGONAL_PATTERN for the generic rasterizer
+    bool inside; // Entirely on screen, drawn without clipping
+} DiagonalLine;
+
+/**
+ * Pixel steps of a diagonal with a given run and rise
+ *
+ * Diagonals only come in a few extents per side length (column width and half side length
+ * both round two ways), so their Bresenham steps are computed once and replayed.
+ */
+typedef struct {
+    uint8_t run; // to.x - from.x
+    uint8_t rise; // |to.y - from.y|
+    uint8_t steps[MAX_DIAGONAL_RUN + 1]; // 1 if y moves one pixel after pixel i, the last entry is 0
+} DiagonalPattern;
+
+// Frame pixel packed as (byte offset << 3) | bit, see FRAME_PAGES
+typedef uint16_t FramePixel;
+
+// Cached triangle of the lattice
+typedef struct {
+    PackedPoint vertices[3]; // Indexed by mirror label, see node_label()
+    PackedPoint center;
+    bool fully_visible;
+} LatticeTriangle;
+
+/**
+ * Geometry of all visible triangles for one side length and origin.
+ * Built by lattice_cache_build() when the side length or the origin changes, replayed by
+ * draw_pattern(). The line positions come from the const tables of lattice_tables.h.
+ */
+typedef struct {
+    int side_length; // Side length the cache was built for, 0 if empty
+    Point origin; // Screen position of the base triangle's left edge at CENTER_Y, see pan_origin()
+    int16_t* column_x; // x of the vertical lines, column_x[i + 1] is the apex of column i
+    int column_count; // Columns starting on screen (= number of vertical lines)
+    int column_min; // Lattice column of column_x[0], negative once the origin moved right
+    int16_t* node_y; // y of the node rows touched by visible triangles
+    int node_row_min; // Node row stored in node_y[0]
+    DiagonalLine* diagonals; // Diagonal edges of right-pointing triangles, upper then lower edge
+    int diagonal_count;
+    DiagonalPattern patterns[MAX_DIAGONAL_PATTERNS];
+    int pattern_count;
+    LatticeTriangle* triangles; // Visible triangles
+    int triangle_count;
+    PackedPoint* centers; // Centroids whose cross reaches the screen, see frame_draw_center()
+    int center_count;
+    int full_triangles;
+    int partial_triangles;
+    int triangle_area;
+    bool columns_repeat; // The columns repeat every two exactly, at any origin, see pan_repeat()
+} LatticeCache;
+
+/**
+ * One period of the pattern: two columns wide and one side length high.
+ * The lattice repeats with this cell, so rasterizing it once and stamping it across the
+ * frame yields the whole pattern.
+ */
+typedef struct {
+    uint64_t columns[MAX_TILE_WIDTH]; // Bit y of columns[x] is tile pixel (x, y)
+    int width;
+    int height;
+} Tile;
+
+// Wallpaper group the mirrors are arranged in
+typedef enum {
+    SymmetryP3m1, // Equilateral triangles, the original three-mirror kaleidoscope
+    SymmetryP6m, // 30-60-90 triangles, the equilateral lattice cut along its medians
+    SymmetryP4m, // 45-45-90 triangles, squares cut along their midlines and diagonals
+    SymmetryP2mm, // Rectangles between two perpendicular pairs of mirrors
+    SymmetryCount,
+} SymmetryGroup;
+
+/**
+ * Fundamental domain and reflection table of a wallpaper group
+ *
+ * The plane is covered by frames of three points: the lattice triangles by mirror label, or
+ * translated cells given as (origin, origin + width, origin + height). All points of a group
+ * are weights of the frame points summing to DOMAIN_SCALE, so one const table describes the
+ * domain images of every frame at every side length.
+ */
+typedef struct {
+    const char* name;
+    bool lattice_frames; // Frames are the lattice triangles, else cells
+    bool lattice_lines; // The lattice lines are mirrors of the group
+    int cell_aspect; // Cells are cell_aspect * (side_length + 1) wide and side_length + 1 high
+    int domain_vertices; // 3, or 4 for a rectangle completed from reference points 0..2
+    int image_count;
+    const int8_t (*images)[3][3]; // Reference points of the domain images per frame, image 0 is the fundamental domain
+    int mirror_count;
+    const int8_t (*mirrors)[2][3]; // Mirror segments per frame besides the lattice lines
+} SymmetryGroupInfo;
+
+// Frames of the current symmetry group for one side length, see symmetry_build()
+typedef struct {
+    const SymmetryGroupInfo* info;
+    SymmetryGroup group;
+    int side_length; // Side length the frames were built for, 0 if empty
+    int frame_count;
+    int base_sign; // Orientation of the fundamental domain
+    int cell_width; // Translation period of cell frames
+    int cell_height;
+    int cell_x; // x of the first cell column
+    int cell_y; // y of the cell holding the fundamental domain
+    int cell_columns; // Cells touching the screen
+    int cell_row_min;
+} Symmetry;
+
+/**
+ * Mirror orbits of the fundamental domain pixels for one side length and symmetry group.
+ * orbit_pixels[orbit_start[i] .. orbit_start[i + 1]) are the screen pixels base pixel i is
+ * mapped to by the reflections onto every visible image of the domain, the domain included.
+ * Base pixels are the pixels strictly inside the fundamental domain, column by column.
+ */
+typedef struct {
+    int side_length; // Side length the table was built for, 0 if empty
+    SymmetryGroup group;
+    int base_count; // Number of base pixels
+    uint16_t* orbit_start; // base_count + 1 offsets into orbit_pixels
+    FramePixel* orbit_pixels;
+    int orbit_size;
+    Point base_vertices[MAX_DOMAIN_VERTICES]; // Fundamental domain in Q8 (MOTION_SHIFT) pixels
+    int base_vertex_count;
+    Point base_center; // Centroid of the domain in Q8 pixels, the rotation center
+    int base_sign; // Orientation of base_vertices, makes the edge functions positive inside
+    int base_x_min; // x of the first base pixel column
+    int base_columns; // Number of base pixel columns
+    int16_t column_first[MAX_BASE_COLUMNS + 1]; // First base pixel index of every column
+    int16_t column_y[MAX_BASE_COLUMNS]; // y of the first base pixel of every column
+} OrbitTable;
+
+// How the pattern is put on screen
+typedef enum {
+    RenderModeLattice, // Replay the cached lattice lines
+    RenderModeTile, // Rasterize one period and stamp it across the frame buffer
+    RenderModeFilled, // Lattice with the right-pointing triangles filled, alternating with the others
+    RenderModeCount,
+} RenderMode;
+
+// How the seeds move while animating
+typedef enum {
+    AnimationOff,
+    AnimationDrift, // Seeds travel in straight lines and bounce off the mirrors
+    AnimationRotate, // Seeds rotate around the center of the base triangle
+    AnimationRegenerate, // One seed after the other is replaced by a new random one
+    AnimationScroll, // The pattern pans diagonally across the screen
+    AnimationCount,
+} AnimationMode;
+
+// Entries of the mode menu
+typedef enum {
+    MenuItemRender,
+    MenuItemSymmetry,
+    MenuItemAnimation,
+    MenuItemFps,
+    MenuItemDraw, // View port or direct draw while animating
+    MenuItemGray, // Number of bitplanes, 1 is plain black and white
+    MenuItemZoom, // Up/Down step the side length or zoom continuously while held
+    MenuItemArrows, // Arrows change size and seeds or pan the pattern
+    MenuItemSeed, // Left/Right step the pattern seed, OK draws a new one
+    MenuItemExport, // OK writes the frame to the SD card
+    MenuItemCount,
+} MenuItem;
+
+// File format of the pattern export
+typedef enum {
+    ExportFormatPbm, // Binary PBM (P4)
+    ExportFormatRle, // PBM header with a PackBits compressed raster
+    ExportFormatCount,
+} ExportFormat;
+
+/**
+ * Lattice of the smooth zoom preview in Q16.16
+ *
+ * Started from the current side length and stepped by zoom_step() on every animation tick;
+ * the column width follows by adding its own step instead of being derived again.
+ */
+typedef struct {
+    int direction; // 1 while Up is held, -1 while Down is held, 0 if not zooming
+    int32_t side_q16; // Side length
+    int32_t column_q16; // Column width, side_q16 * sqrt(3)/2
+    int32_t side_step_q16; // Change of both per tick
+    int32_t column_step_q16;
+} Zoom;
+
+// Sub-pixel position and velocity of a seed, Q8 fixed point
+typedef struct {
+    int32_t x;
+    int32_t y;
+    int32_t vx;
+    int32_t vy;
+} SeedMotion;
+
+// Settings file contents, see settings_load() and settings_save()
+typedef enum {
+    SettingsFlagLines = (1 << 0),
+    SettingsFlagInfo = (1 << 1),
+    SettingsFlagDirect = (1 << 2),
+    SettingsFlagSmoothZoom = (1 << 3),
+    SettingsFlagPanKeys = (1 << 4),
+} SettingsFlag;
+
+typedef struct {
+    uint8_t side_length;
+    uint8_t flags; // SettingsFlag
+    uint8_t render_mode;
+    uint8_t animation_mode;
+    uint8_t animation_fps;
+    uint8_t seed_count;
+    uint8_t symmetry_group;
+    uint8_t gray_planes;
+    uint16_t export_next;
+    uint32_t random_seed;
+    uint32_t random_state;
+    uint16_t seeds[MAX_SEEDS]; // Base pixel indices for side_length
+} AppSettings;
+
+// Events handled by the main loop
+typedef enum {
+    AppEventTypeInput,
+    AppEventTypeTick, // Animation timer fired
+    AppEventTypeRendered, // The render worker finished its job
+#ifdef KARL_EIDO_TELEMETRY
+    AppEventTypeTelemetry, // Time to log the telemetry
+#endif
+} AppEventType;
+
+typedef struct {
+    AppEventType type;
+    InputEvent input;
+#ifdef KARL_EIDO_TELEMETRY
+    uint32_t cycles; // DWT count at which an input event was queued
+#endif
+} AppEvent;
+
+// Geometry kernels timed one by one by the kernel benchmark, see kernel_run()
+typedef enum {
+    KernelVertices, // get_triangle_vertices() for every lattice triangle
+    KernelVisibility, // The on screen tests of lattice_cache_build()
+    KernelCenters, // get_triangle_center() for every lattice triangle
+    KernelLines, // frame_draw_diagonal() for every cached diagonal
+    KernelTile, // tile_stamp()
+    KernelOrbits, // orbit_table_build()
+    KernelSeeds, // frame_toggle_seed() for every seed, twice
+    KernelCount,
+} Kernel;
+
+// Fastest DWT cycles per run of every kernel and side length in 1/KERNEL_CYCLE_SCALE cycles, saved as the
+// kernel benchmark baseline
+typedef struct {
+    uint32_t cycles[KernelCount][LATTICE_TABLE_SIZE_COUNT];
+} KernelResults;
+
+// Result of the render benchmark, times in microseconds per frame
+typedef struct {
+    uint32_t min_us;
+    uint32_t max_us;
+    uint32_t worst_median_us; // Median of the slowest configuration
+    uint32_t median_sum_us; // Sum of the medians of all configurations
+    int worst_side_length;
+    int worst_config; // Bit 0: lines, bit 1: centers
+    int configurations;
+    int kernel_results; // Kernel medians measured, 0 if the kernel benchmark failed
+    int kernel_regressions; // Kernel medians more than KERNEL_REGRESSION_PERCENT above the baseline
+    bool kernel_baseline_saved; // There was no baseline, this run became it
+} BenchmarkReport;
+
+#ifdef KARL_EIDO_PROFILE
+// Stages of a frame timed by the profiling page
+typedef enum {
+    ProfileStageGrid, // Lattice and orbit table rebuild, only runs when the side length changes
+    ProfileStageClear, // Clearing the frame
+    ProfileStageLines, // Lattice lines, or tile build and stamp in tile mode
+    ProfileStageCenters,
+    ProfileStageSeeds,
+    ProfileStageText, // Overlay text in the render callback
+    ProfileStageCount,
+} ProfileStage;
+
+// Cycle counts per stage
+typedef struct {
+    uint32_t last[ProfileStageCount];
+    uint32_t average[ProfileStageCount];
+    uint32_t peak[ProfileStageCount];
+} ProfileStats;
+
+/**
+ * Start timing a block of stages, compiles to nothing without KARL_EIDO_PROFILE
+ */
+#define PROFILE_BEGIN() uint32_t profile_mark = DWT->CYCCNT
+
+/**
+ * Account the cycles since the previous mark to a stage
+ */
+#define PROFILE_END(stats, stage)                                   \
+    do {                                                            \
+        uint32_t profile_now = DWT->CYCCNT;                         \
+        profile_record((stats), (stage), profile_now - profile_mark); \
+        profile_mark = profile_now;                                 \
+    } while(0)
+#else
+#define PROFILE_BEGIN()
+#define PROFILE_END(stats, stage)
+#endif
+
+#ifdef KARL_EIDO_TELEMETRY
+// Samples in microseconds since the app started, in power of two buckets
+typedef struct {
+    atomic_uint counts[TELEMETRY_BUCKETS];
+    atomic_uint peak_us; // Slowest sample since the last dump
+} TelemetryHistogram;
+
+/**
+ * Long running frame statistics, logged every TELEMETRY_DUMP_MS
+ *
+ * Frame times are written by the main loop, job times by the render worker, latencies by
+ * whichever thread draws the canvas; all counters are relaxed atomics, the dump only needs
+ * each of them to be untorn.
+ */
+typedef struct {
+    TelemetryHistogram frame; // Main loop work per drawn frame: events, render, publish and show
+    TelemetryHistogram rebuild; // Render worker geometry jobs
+    TelemetryHistogram render; // Render worker frame jobs: layers redrawn and composed
+    TelemetryHistogram latency; // Oldest input of a frame until that frame was in the canvas
+    atomic_uint latency_start; // DWT count of the input the next drawn frame answers, 0 if none
+    uint32_t frames_skipped; // frames_skipped at the last dump
+    FuriTimer* timer;
+    char line[TELEMETRY_LINE_SIZE]; // Log line scratch, too big for the app stack
+} Telemetry;
+#endif
+
+// Cached layers of a render, each one is drawn only when what it shows changed
+typedef enum {
+    RenderLayerFill = (1 << 0), // Fill of the filled mode, plane 0 only
+    RenderLayerLines = (1 << 1), // Lattice and mirror lines
+    RenderLayerCenters = (1 << 2), // Center points of the info mode
+    RenderLayerSeeds = (1 << 3), // Seed orbits of every bitplane
+    RenderLayerAll = 0x0F,
+} RenderLayer;
+
+/**
+ * Input of a full render: copies of the render settings and seeds, the geometry they are
+ * rendered with and scratch space. Filled by render_job_init(), read by draw_plane().
+ */
+typedef struct {
+    uint8_t layers; // RenderLayer bits the render worker draws again, see render_layers_update()
+    bool show_lines;
+    bool show_info;
+    RenderMode render_mode;
+    int gray_planes;
+    int seed_count;
+    uint16_t seeds[MAX_SEEDS];
+    const LatticeCache* lattice;
+    const Symmetry* symmetry;
+    const OrbitTable* orbits;
+    Tile* tile; // Tile mode scratch space
+#ifdef KARL_EIDO_PROFILE
+    ProfileStats* profile;
+#endif
+} RenderJob;
+
+// Jobs of the render worker
+typedef enum {
+    RenderWorkIdle,
+    RenderWorkGeometry, // Build lattice, symmetry frames and orbit table into the back geometry
+    RenderWorkFrame, // Render every bitplane into the back buffer
+} RenderWork;
+
+// Thread flags of the render worker
+typedef enum {
+    RenderWorkerFlagJob = (1 << 0),
+    RenderWorkerFlagExit = (1 << 1),
+} RenderWorkerFlag;
+
+/**
+ * Layer bitmaps of the render worker, every bitplane is composed from them
+ *
+ * The fill, line and center layers are kept across frame jobs and only drawn again when
+ * their inputs changed; the seed layers follow the seed list by difference.
+ */
+typedef struct {
+    uint8_t fill[FRAME_SIZE];
+    uint8_t lines[FRAME_SIZE];
+    uint8_t centers[FRAME_SIZE];
+    uint8_t seeds[GRAY_MAX_PLANES][FRAME_SIZE]; // Seeds of each bitplane
+    uint16_t seeds_drawn[MAX_SEEDS]; // Seeds the seed layers hold, by slot
+    int seed_count;
+    int seed_planes; // Plane count the seed levels were drawn for
+} RenderLayers;
+
+/**
+ * Low priority thread doing the work that can take longer than a frame
+ *
+ * Handles one job at a time. The main thread fills in the job, sets RenderWorkerFlagJob and
+ * leaves everything here alone until the AppEventTypeRendered event; only then it takes over
+ * the back geometry or the back buffer, see render_worker_finish().
+ */
+typedef struct {
+    FuriThread* thread;
+    RenderWork work; // Job in flight, RenderWorkIdle if none
+    int side_length; // Geometry job: settings to build for
+    SymmetryGroup group;
+    Point origin;
+    bool geometry_built; // Geometry job: result
+    LatticeCache lattice; // Back geometry
+    Symmetry symmetry;
+    OrbitTable orbits;
+    Arena arena; // Region the back geometry is carved from
+    RenderJob job; // Frame job: what to render, against the front geometry
+    Tile tile;
+    RenderLayers layers; // Frame job: what the last frame job drew
+    uint8_t frames[GRAY_MAX_PLANES][FRAME_SIZE]; // Back buffer
+#ifdef KARL_EIDO_PROFILE
+    ProfileStats profile; // Stages timed by the worker, merged on finish
+#endif
+} RenderWorker;
+
+// Numbers of the info overlay, its text is only formatted again when one of them changes
+typedef struct {
+    int side_length;
+    int line_count;
+    int full_triangles;
+    int partial_triangles;
+    int white_pixels;
+    uint32_t random_seed;
+    int idle_percent;
+    int wakeups_per_10s;
+    uint32_t stack_free_main; // Lowest free stack of the threads in bytes
+    uint32_t stack_free_worker;
+    uint32_t stack_free_gui;
+    uint32_t heap_free_min; // Lowest free heap since boot in bytes
+    int arena_percent; // Peak use of the geometry regions
+} InfoValues;
+
+// Info overlay text and the numbers it was formatted from
+typedef struct {
+    InfoValues values;
+    bool formatted; // lines hold the text of values
+    char lines[INFO_LINES][INFO_LINE_SIZE];
+} InfoText;
+
+// Everything the overlays read, copied out of AppState on publish
+typedef struct {
+    char info[INFO_LINES][INFO_LINE_SIZE]; // Text of the info overlay, see info_text_update()
+    bool show_info;
+    bool menu_open;
+    MenuItem menu_item;
+    RenderMode render_mode;
+    SymmetryGroup symmetry_group;
+    int gray_planes;
+    AnimationMode animation_mode;
+    int animation_fps;
+    bool direct_draw;
+    bool smooth_zoom;
+    bool pan_keys;
+    bool benchmark_open;
+    BenchmarkReport benchmark;
+    ExportFormat export_format;
+    int export_result;
+    uint32_t random_seed;
+#ifdef KARL_EIDO_PROFILE
+    bool show_profile;
+    ProfileStats profile;
+#endif
+} RenderOverlay;
+
+// Immutable copy of what the render callback draws
+typedef struct {
+    uint8_t frames[GRAY_MAX_PLANES][FRAME_SIZE]; // overlay.gray_planes of them are valid
+    RenderOverlay overlay;
+    unsigned int generation; // Number of the publish, tells a new snapshot from a redraw of the old one
+} RenderSnapshot;
+
+/**
+ * Seqlock protected snapshot slot
+ *
+ * The sequence is odd while the main thread writes the slot. A reader that sees the same
+ * even sequence before and after copying got a consistent snapshot.
+ */
+typedef struct {
+    atomic_uint sequence;
+    RenderSnapshot snapshot;
+} SnapshotSlot;
+
 // Application state
 typedef struct {
     int side_length;
     bool show_lines;
     bool show_info;
     bool running;
+    RenderMode render_mode;
+    SymmetryGroup symmetry_group;
+    LatticeCache lattice;
+    Symmetry symmetry;
+    Tile tile;
+    OrbitTable orbits;
+    uint16_t seeds[MAX_SEEDS]; // Base pixel indices of the random pixels
+    int seed_count;
+    uint32_t seed_bits[SEED_BITMAP_WORDS]; // Bit i is set if base pixel i is a seed
+    uint32_t random_seed; // The seed placement follows from this number
+    uint32_t random_state; // xorshift32 state, never 0
+    SeedMotion motion[MAX_SEEDS];
+    int regenerate_next; // Next seed replaced by AnimationRegenerate
+    uint8_t frame[FRAME_SIZE]; // Persistent frame holding the pattern without the debug info
+    int gray_planes; // Bitplanes of the pattern, frame is the first one
+    uint8_t gray_frames[GRAY_MAX_PLANES - 1][FRAME_SIZE]; // The other bitplanes
+    int frame_planes; // Bitplanes the frames were rendered with, lags gray_planes until the next render
+    bool frame_dirty; // The frames have to be composed again by the render worker
+    uint8_t layers_dirty; // RenderLayer bits the next frame job draws again
+    bool frame_stale; // The frames belong to the previous geometry and are not published
+    RenderWorker worker;
+    Arena geometry_arena; // Region the front geometry is carved from
+    size_t geometry_peak; // Peak use of either geometry region seen so far
+    atomic_uint stack_free_gui; // Written by the render callback
+    uint32_t startup_cycles; // DWT count at launch
+    atomic_uint first_frame_cycles; // Launch to the first drawn frame, 0 until it is drawn
+    InfoText info_text; // Main thread only, copied into the snapshots
+    bool menu_open;
+    MenuItem menu_item;
+    AnimationMode animation_mode;
+    int animation_fps;
+    bool smooth_zoom; // Up/Down zoom continuously while held instead of stepping
+    Zoom zoom;
+    bool pan_keys; // The arrows pan the pattern instead of changing size and seeds
+    Point pan; // Distance the pattern was panned by, the frames always show it there
+    Point pan_direction; // Held pan key, (0, 0) if none
+    FuriMessageQueue* event_queue;
+    FuriTimer* animation_timer;
+    uint32_t animation_period; // Ticks the animation timer runs with, 0 while it is stopped
+    FuriTimer* gray_timer; // Shows the next bitplane, never wakes the main loop
+    ViewPort* view_port;
+    Gui* gui;
+    bool direct_draw; // Animation frames are drawn by the main loop, see direct_draw_update()
+    Canvas* direct_canvas; // Acquired direct draw canvas, NULL while the view port draws
+    atomic_bool direct_active; // Input comes from the input events pubsub, not the view port
+    FuriPubSub* input_events;
+    FuriPubSubSubscription* input_subscription;
+    atomic_uint gray_tick; // Bitplane flips so far, the render callback shows plane gray_tick % planes
+    unsigned int snapshot_generation; // Publishes so far, main thread only
+    atomic_uint shown_generation; // Generation of the snapshot drawn last
+    atomic_bool frame_pending; // A tick was queued and its frame is not drawn yet
+    uint32_t frame_pending_since; // Tick at which frame_pending was set
+    uint32_t frames_skipped; // Timer ticks dropped because the last frame was still pending
+    bool benchmark_open; // The benchmark report is shown
+    BenchmarkReport benchmark;
+    uint32_t idle_window_start; // Tick at which the current idle window started
+    uint32_t idle_ticks; // Ticks spent waiting for events in the current window
+    uint32_t wakeups; // Events received in the current window
+    int idle_percent; // Share of the last window spent waiting for events
+    int wakeups_per_10s; // Event rate of the last window
+    ExportFormat export_format;
+    int export_next; // First free file number, found once by export_next_find()
+    int export_result; // Number of the last exported file, EXPORT_NONE or EXPORT_FAILED
+    uint8_t export_buffer[EXPORT_BUFFER_SIZE]; // File image of the export
+    SnapshotSlot snapshots[2]; // Double buffer shared with the render callback
+    atomic_uint snapshot_published; // Slot holding the newest snapshot
+#ifdef KARL_EIDO_PROFILE
+    bool show_profile; // The profiling page replaces the info line
+    ProfileStats profile;
+    atomic_uint text_cycles; // Written by the render callback, accounted on the next publish
+#endif
+#ifdef KARL_EIDO_TELEMETRY
+    Telemetry telemetry;
+#endif
 } AppState;
 
 /**
- * Calculate the height of an equilateral triangle given its side length
- * Height = side_length * sqrt(3)/2
+ * Calculate triangle vertices from the lattice lines around it
+ * 
+ * @param vertices Output array for 3 vertices
+ * @param x_left x of the vertical line left of the column
+ * @param x_right x of the vertical line right of the column
+ * @param node_y y of the node rows row - 1, row and row + 1
+ * @param pointing_right True if triangle points right, false if points left
+ */
+static void get_triangle_vertices(
+    Point* vertices,
+    int x_left,
+    int x_right,
+    const int16_t* node_y,
+    bool pointing_right) {
+    
+    if(pointing_right) {
+        // Triangle pointing right: |>
+        vertices[0].x = x_left;
+        vertices[0].y = node_y[0];
+        vertices[1].x = x_left;
+        vertices[1].y = node_y[2];
+        vertices[2].x = x_right;
+        vertices[2].y = node_y[1];
+    } else {
+        // Triangle pointing left: <|
+        vertices[0].x = x_left;
+        vertices[0].y = node_y[1];
+        vertices[1].x = x_right;
+        vertices[1].y = node_y[0];
+        vertices[2].x = x_right;
+        vertices[2].y = node_y[2];
+    }
+}
+
+/**
+ * Mirror label (0..2) of a lattice node
+ *
+ * Node (col, k) lies at (0, 1) + i * (0, 2) + j * (1, 1) with j = col. Neighbouring nodes
+ * differ in (i - j) mod 3, so the label names the vertex of the base triangle that the
+ * reflections map onto this node.
+ */
+static int node_label(int col, int node_row) {
+    int label = ((node_row - 1 - col) / 2 - col) % 3;
+    return (label < 0) ? label + 3 : label;
+}
+
+/**
+ * Mirror labels of the vertices returned by get_triangle_vertices()
+ */
+static void get_vertex_labels(int* labels, int col, int row, bool pointing_right) {
+    if(pointing_right) {
+        labels[0] = node_label(col, row - 1);
+        labels[1] = node_label(col, row + 1);
+        labels[2] = node_label(col + 1, row);
+    } else {
+        labels[0] = node_label(col, row);
+        labels[1] = node_label(col + 1, row - 1);
+        labels[2] = node_label(col + 1, row + 1);
+    }
+}
+
+/**
+ * Floor division for a positive divisor
+ */
+static int floor_div(int value, int divisor) {
+    return (value >= 0) ? value / divisor : -((divisor - 1 - value) / divisor);
+}
+
+/**
+ * Ceiling division for a positive divisor
+ */
+static int ceil_div(int value, int divisor) {
+    return -floor_div(-value, divisor);
+}
+
+/**
+ * Calculate the center (centroid) of a triangle
+ */
+static Point get_triangle_center(Point* vertices) {
+    Point center;
+    // Rounded down also off screen, so a pan moves the centers with the triangles
+    center.x = floor_div(vertices[0].x + vertices[1].x + vertices[2].x, 3);
+    center.y = floor_div(vertices[0].y + vertices[1].y + vertices[2].y, 3);
+    return center;
+}
+
+static PackedPoint pack_point(Point point) {
+    PackedPoint packed = {.x = (int16_t)point.x, .y = (int16_t)point.y};
+    return packed;
+}
+
+/**
+ * Set up an arena over a block of memory
+ */
+static void arena_init(Arena* arena, void* base, size_t size) {
+    arena->base = base;
+    arena->size = size;
+    arena->used = 0;
+    arena->peak = 0;
+}
+
+/**
+ * Carve a block from the arena
+ *
+ * @return the block, NULL if the arena is exhausted
+ */
+static void* arena_alloc(Arena* arena, size_t size) {
+    size = ARENA_ALIGN(size);
+    if(arena->base == NULL || arena->size - arena->used < size) return NULL;
+    void* block = arena->base + arena->used;
+    arena->used += size;
+    arena->peak = MAX(arena->peak, arena->used);
+    return block;
+}
+
+/**
+ * Give back every block carved from the arena
+ */
+static void arena_reset(Arena* arena) {
+    arena->used = 0;
+}
+
+/**
+ * Give back the blocks carved since the arena was at the given use, see Arena.used
+ */
+static void arena_rewind(Arena* arena, size_t used) {
+    arena->used = MIN(arena->used, used);
+}
+
+/**
+ * Drop the lattice cache, its memory goes back with the arena it was carved from
+ */
+static void lattice_cache_clear(LatticeCache* cache) {
+    memset(cache, 0, sizeof(LatticeCache));
+}
+
+/**
+ * Step pattern for a diagonal, computed on first use
+ *
+ * Runs the same Bresenham as frame_draw_line() from (0, 0) to (run, rise), so replaying
+ * the pattern sets exactly the same pixels.
+ *
+ * @return Pattern index, NO_DIAGONAL_PATTERN if the line has no single pixel per column
+ */
+static uint8_t diagonal_pattern_get(LatticeCache* cache, int run, int rise) {
+    for(int i = 0; i < cache->pattern_count; i++) {
+        if(cache->patterns[i].run == run && cache->patterns[i].rise == rise) return (uint8_t)i;
+    }
+    if(cache->pattern_count == MAX_DIAGONAL_PATTERNS || run > MAX_DIAGONAL_RUN || rise >= run) {
+        return NO_DIAGONAL_PATTERN;
+    }
+    
+    DiagonalPattern* pattern = &cache->patterns[cache->pattern_count];
+    pattern->run = (uint8_t)run;
+    pattern->rise = (uint8_t)rise;
+    int error = run - rise;
+    for(int i = 0; i < run; i++) {
+        int error2 = 2 * error;
+        if(error2 < -rise) return NO_DIAGONAL_PATTERN; // Would step y without x
+        error -= rise;
+        pattern->steps[i] = (error2 <= run);
+        if(pattern->steps[i]) error += run;
+    }
+    pattern->steps[run] = 0;
+    return (uint8_t)cache->pattern_count++;
+}
+
+/**
+ * Append a diagonal from its left end point to its right end point
+ */
+static void diagonal_add(LatticeCache* cache, Point from, Point to) {
+    DiagonalLine* line = &cache->diagonals[cache->diagonal_count++];
+    line->from = pack_point(from);
+    line->to = pack_point(to);
+    line->pattern = diagonal_pattern_get(cache, to.x - from.x, abs(to.y - from.y));
+    line->inside = from.x >= 0 && to.x < SCREEN_WIDTH && from.y >= 0 && from.y < SCREEN_HEIGHT &&
+                   to.y >= 0 && to.y < SCREEN_HEIGHT;
+}
+
+/**
+ * True if a triangle between the lattice lines lies entirely on screen
+ *
+ * @param node_y y of the node rows around the triangle, see get_triangle_vertices()
+ */
+static bool triangle_fully_visible(int x_left, int x_right, const int16_t* node_y) {
+    return x_left >= 0 && x_right < SCREEN_WIDTH && node_y[0] >= 0 && node_y[2] < SCREEN_HEIGHT;
+}
+
+/**
+ * True if the bounding box of a triangle between the lattice lines overlaps the screen
+ */
+static bool triangle_touches_screen(int x_left, int x_right, const int16_t* node_y) {
+    return x_left < SCREEN_WIDTH && x_right >= 0 && node_y[0] < SCREEN_HEIGHT && node_y[2] >= 0;
+}
+
+static bool point_on_screen(Point point) {
+    return point.x >= 0 && point.x < SCREEN_WIDTH && point.y >= 0 && point.y < SCREEN_HEIGHT;
+}
+
+/**
+ * Build the lattice cache for the given side length
+ *
+ * An origin right of or below (0, 0) uncovers columns left of the mirror at the base
+ * triangle, which mirror the table columns right of it, and node rows above the table,
+ * which follow its formula.
+ *
+ * @param cache Cache to (re)build, previous contents are dropped
+ * @param side_length Side length of the triangles
+ * @param origin Screen position of the lattice, both coordinates within one pan_period()
+ * @param arena Arena the cache is carved from
+ * @return true on success, false if the arena is exhausted
+ */
+static bool lattice_cache_build(LatticeCache* cache, int side_length, Point origin, Arena* arena) {
+    lattice_cache_clear(cache);
+    if(side_length < MIN_SIDE_LENGTH || side_length > MAX_SIDE_LENGTH ||
+       (side_length - MIN_SIDE_LENGTH) % SIDE_LENGTH_STEP != 0) {
+        return false;
+    }
+    
+    const LatticeGeometry* geometry =
+        &lattice_geometry[(side_length - MIN_SIDE_LENGTH) / SIDE_LENGTH_STEP];
+    const uint8_t* table_x = &lattice_column_x[geometry->column_offset];
+    const int8_t* table_y = &lattice_node_y[geometry->node_offset];
+    int column_min = 0;
+    // Also the column that only reaches the screen with its right edge
+    while(column_min > -geometry->column_count && origin.x - table_x[-column_min] >= 0) column_min--;
+    int column_max = geometry->column_count - 1;
+    // The tile and the base frame need the first two columns, even if the second starts right of the screen
+    while(column_max > 1 && origin.x + table_x[column_max] >= SCREEN_WIDTH) column_max--;
+    int row_min = geometry->row_min;
+    // Rows reaching down to the screen, like the tables: the bottom node of the row above is on or below y = 0
+    while(origin.y > 0 && CENTER_Y + ((row_min * side_length + 1) >> 1) + origin.y >= 0) row_min--;
+    
+    int num_rows = geometry->row_max - row_min + 1;
+    bool moved = origin.x != 0 || origin.y != 0;
+    cache->origin = origin;
+    cache->column_count = column_max - column_min + 1;
+    cache->column_min = column_min;
+    cache->node_row_min = row_min - 1;
+    cache->full_triangles = moved ? 0 : geometry->full_triangles;
+    cache->partial_triangles = moved ? 0 : geometry->partial_triangles;
+    cache->triangle_area = geometry->triangle_area;
+    // Every column is rounded on its own; origins within one period start at column -2 at most
+    cache->columns_repeat = true;
+    for(int col = -2; col + 2 <= geometry->column_count; col++) {
+        int x = (col < 0) ? -table_x[-col] : table_x[col];
+        if(table_x[col + 2] - x != table_x[2]) cache->columns_repeat = false;
+    }
+    
+    int max_triangles = cache->column_count * num_rows;
+    cache->column_x = arena_alloc(arena, sizeof(int16_t) * (cache->column_count + 1));
+    cache->node_y = arena_alloc(arena, sizeof(int16_t) * (num_rows + 2));
+    cache->diagonals = arena_alloc(arena, sizeof(DiagonalLine) * cache->column_count * (num_rows + 1));
+    cache->triangles = arena_alloc(arena, sizeof(LatticeTriangle) * max_triangles);
+    cache->centers = arena_alloc(arena, sizeof(PackedPoint) * max_triangles);
+    if(cache->column_x == NULL || cache->node_y == NULL || cache->diagonals == NULL || cache->triangles == NULL ||
+       cache->centers == NULL) {
+        lattice_cache_clear(cache);
+        return false;
+    }
+    
+    for(int col = column_min; col <= column_max + 1; col++) {
+        cache->column_x[col - column_min] = (int16_t)(origin.x + ((col < 0) ? -table_x[-col] : table_x[col]));
+    }
+    for(int i = 0; i < num_rows + 2; i++) {
+        int node_row = cache->node_row_min + i;
+        int table_row = node_row - (geometry->row_min - 1);
+        int y = (table_row >= 0) ? table_y[table_row] : CENTER_Y + ((node_row * side_length + 1) >> 1);
+        cache->node_y[i] = (int16_t)(origin.y + y);
+    }
+    
+    for(int col = column_min; col <= column_max; col++) {
+        int x_left = cache->column_x[col - column_min];
+        int x_right = cache->column_x[col - column_min + 1];
+        
+        const int16_t* node_y = cache->node_y;
+        for(int row = row_min; row <= geometry->row_max; row++, node_y++) {
+            bool pointing_right = ((col + row) % 2 == 0);
+            
+            Point vertices[3];
+            get_triangle_vertices(vertices, x_left, x_right, node_y, pointing_right);
+            
+            // Diagonal lines only from right-pointing triangles to avoid duplicates:
+            // upper diagonal from top vertex to right apex, lower from bottom vertex to right apex
+            if(pointing_right) {
+                diagonal_add(cache, vertices[0], vertices[2]);
+                diagonal_add(cache, vertices[1], vertices[2]);
+            }
+            
+            LatticeTriangle* triangle = &cache->triangles[cache->triangle_count++];
+            int labels[3];
+            get_vertex_labels(labels, col, row, pointing_right);
+            for(int i = 0; i < 3; i++) {
+                triangle->vertices[labels[i]] = pack_point(vertices[i]);
+            }
+            Point center = get_triangle_center(vertices);
+            triangle->center = pack_point(center);
+            triangle->fully_visible = triangle_fully_visible(x_left, x_right, node_y);
+            if(moved && triangle_touches_screen(x_left, x_right, node_y)) {
+                // Counted like the tables, which only cover the origin at (0, 0)
+                if(triangle->fully_visible) {
+                    cache->full_triangles++;
+                } else {
+                    cache->partial_triangles++;
+                }
+            }
+            
+            // Also the ones just off screen, a pan copies the edges of the frame inwards
+            if(center.x >= -1 && center.x <= SCREEN_WIDTH && center.y >= -1 && center.y <= SCREEN_HEIGHT) {
+                cache->centers[cache->center_count++] = triangle->center;
+            }
+        }
+    }
+    
+    cache->side_length = side_length;
+    return true;
+}
+
+/**
+ * Signed double area of the triangle (a, b, p), positive if p lies left of a -> b
+ */
+static int edge_function(Point a, Point b, Point p) {
+    return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+}
+
+// Frame weights of the vertices (by mirror label), edge midpoints and centroid of a lattice triangle
+#define TRIANGLE_V0 {6, 0, 0}
+#define TRIANGLE_V1 {0, 6, 0}
+#define TRIANGLE_V2 {0, 0, 6}
+#define TRIANGLE_M01 {3, 3, 0}
+#define TRIANGLE_M12 {0, 3, 3}
+#define TRIANGLE_M20 {3, 0, 3}
+#define TRIANGLE_C {2, 2, 2}
+
+// Frame weights of a cell point, u and v count half cell widths and heights
+#define CELL_POINT(u, v) {6 - 3 * (u) - 3 * (v), 3 * (u), 3 * (v)}
+
+// p3m1: the fundamental domain is the lattice triangle itself
+static const int8_t p3m1_images[][3][3] = {
+    {TRIANGLE_V0, TRIANGLE_V1, TRIANGLE_V2},
+};
+
+// p6m: six domains per lattice triangle as (vertex, edge midpoint, centroid)
+static const int8_t p6m_images[][3][3] = {
+    {TRIANGLE_V0, TRIANGLE_M01, TRIANGLE_C},
+    {TRIANGLE_V1, TRIANGLE_M01, TRIANGLE_C},
+    {TRIANGLE_V1, TRIANGLE_M12, TRIANGLE_C},
+    {TRIANGLE_V2, TRIANGLE_M12, TRIANGLE_C},
+    {TRIANGLE_V2, TRIANGLE_M20, TRIANGLE_C},
+    {TRIANGLE_V0, TRIANGLE_M20, TRIANGLE_C},
+};
+
+static const int8_t p6m_mirrors[][2][3] = {
+    {TRIANGLE_V0, TRIANGLE_M12},
+    {TRIANGLE_V1, TRIANGLE_M20},
+    {TRIANGLE_V2, TRIANGLE_M01},
+};
+
+// p4m: eight domains per square cell as (corner, edge midpoint, center)
+static const int8_t p4m_images[][3][3] = {
+    {CELL_POINT(0, 0), CELL_POINT(1, 0), CELL_POINT(1, 1)},
+    {CELL_POINT(2, 0), CELL_POINT(1, 0), CELL_POINT(1, 1)},
+    {CELL_POINT(2, 0), CELL_POINT(2, 1), CELL_POINT(1, 1)},
+    {CELL_POINT(2, 2), CELL_POINT(2, 1), CELL_POINT(1, 1)},
+    {CELL_POINT(2, 2), CELL_POINT(1, 2), CELL_POINT(1, 1)},
+    {CELL_POINT(0, 2), CELL_POINT(1, 2), CELL_POINT(1, 1)},
+    {CELL_POINT(0, 2), CELL_POINT(0, 1), CELL_POINT(1, 1)},
+    {CELL_POINT(0, 0), CELL_POINT(0, 1), CELL_POINT(1, 1)},
+};
+
+// Top and left edge (the others belong to the neighbouring cells), midlines, diagonals
+static const int8_t p4m_mirrors[][2][3] = {
+    {CELL_POINT(0, 0), CELL_POINT(2, 0)},
+    {CELL_POINT(0, 0), CELL_POINT(0, 2)},
+    {CELL_POINT(1, 0), CELL_POINT(1, 2)},
+    {CELL_POINT(0, 1), CELL_POINT(2, 1)},
+    {CELL_POINT(0, 0), CELL_POINT(2, 2)},
+    {CELL_POINT(2, 0), CELL_POINT(0, 2)},
+};
+
+// p2mm: four rectangles per cell, reference points are three of their corners
+static const int8_t p2mm_images[][3][3] = {
+    {CELL_POINT(0, 0), CELL_POINT(1, 0), CELL_POINT(1, 1)},
+    {CELL_POINT(2, 0), CELL_POINT(1, 0), CELL_POINT(1, 1)},
+    {CELL_POINT(0, 2), CELL_POINT(1, 2), CELL_POINT(1, 1)},
+    {CELL_POINT(2, 2), CELL_POINT(1, 2), CELL_POINT(1, 1)},
+};
+
+static const int8_t p2mm_mirrors[][2][3] = {
+    {CELL_POINT(0, 0), CELL_POINT(2, 0)},
+    {CELL_POINT(0, 1), CELL_POINT(2, 1)},
+    {CELL_POINT(0, 0), CELL_POINT(0, 2)},
+    {CELL_POINT(1, 0), CELL_POINT(1, 2)},
+};
+
+static const SymmetryGroupInfo symmetry_groups[SymmetryCount] = {
+    [SymmetryP3m1] =
+        {.name = "p3m1",
+         .lattice_frames = true,
+         .lattice_lines = true,
+         .domain_vertices = 3,
+         .image_count = COUNT_OF(p3m1_images),
+         .images = p3m1_images},
+    [SymmetryP6m] =
+        {.name = "p6m",
+         .lattice_frames = true,
+         .lattice_lines = true,
+         .domain_vertices = 3,
+         .image_count = COUNT_OF(p6m_images),
+         .images = p6m_images,
+         .mirror_count = COUNT_OF(p6m_mirrors),
+         .mirrors = p6m_mirrors},
+    [SymmetryP4m] =
+        {.name = "p4m",
+         .cell_aspect = 1,
+         .domain_vertices = 3,
+         .image_count = COUNT_OF(p4m_images),
+         .images = p4m_images,
+         .mirror_count = COUNT_OF(p4m_mirrors),
+         .mirrors = p4m_mirrors},
+    [SymmetryP2mm] =
+        {.name = "p2mm",
+         .cell_aspect = 2,
+         .domain_vertices = 4,
+         .image_count = COUNT_OF(p2mm_images),
+         .images = p2mm_images,
+         .mirror_count = COUNT_OF(p2mm_mirrors),
+         .mirrors = p2mm_mirrors},
+};
+
+/**
+ * Point given by frame weights, in DOMAIN_SCALE units
+ */
+static Point symmetry_point(const Point* frame, const int8_t* weights) {
+    Point point = {.x = 0, .y = 0};
+    for(int i = 0; i < 3; i++) {
+        point.x += weights[i] * frame[i].x;
+        point.y += weights[i] * frame[i].y;
+    }
+    return point;
+}
+
+/**
+ * Vertices of one domain image of a frame, in DOMAIN_SCALE units
+ *
+ * @return Number of vertices, a rectangle gets its fourth corner opposite of reference point 1
+ */
+static int symmetry_image(const SymmetryGroupInfo* info, const Point* frame, int image, Point* vertices) {
+    for(int i = 0; i < 3; i++) {
+        vertices[i] = symmetry_point(frame, info->images[image][i]);
+    }
+    if(info->domain_vertices == 4) {
+        vertices[3].x = vertices[0].x + vertices[2].x - vertices[1].x;
+        vertices[3].y = vertices[0].y + vertices[2].y - vertices[1].y;
+    }
+    return info->domain_vertices;
+}
+
+/**
+ * Pixel nearest to a point in DOMAIN_SCALE units
+ */
+static Point symmetry_pixel(Point point) {
+    Point pixel = {
+        .x = floor_div(point.x + DOMAIN_SCALE / 2, DOMAIN_SCALE),
+        .y = floor_div(point.y + DOMAIN_SCALE / 2, DOMAIN_SCALE),
+    };
+    return pixel;
+}
+
+/**
+ * Centroid of a domain image, truncated like get_triangle_center()
+ */
+static Point symmetry_centroid(const Point* vertices, int count) {
+    Point center = {.x = 0, .y = 0};
+    for(int i = 0; i < count; i++) {
+        center.x += vertices[i].x;
+        center.y += vertices[i].y;
+    }
+    center.x = floor_div(center.x, count * DOMAIN_SCALE);
+    center.y = floor_div(center.y, count * DOMAIN_SCALE);
+    return center;
+}
+
+/**
+ * Frame of the cell with its top left corner at (x, y)
+ */
+static void symmetry_cell_frame(const Symmetry* symmetry, int x, int y, Point* frame) {
+    frame[0].x = x;
+    frame[0].y = y;
+    frame[1].x = x + symmetry->cell_width;
+    frame[1].y = y;
+    frame[2].x = x;
+    frame[2].y = y + symmetry->cell_height;
+}
+
+/**
+ * Frame points of frame index in pixels, frames cover every pixel of the screen
+ */
+static void symmetry_frame(const Symmetry* symmetry, const LatticeCache* lattice, int index, Point* frame) {
+    if(symmetry->info->lattice_frames) {
+        const PackedPoint* vertices = lattice->triangles[index].vertices;
+        for(int i = 0; i < 3; i++) {
+            frame[i].x = vertices[i].x;
+            frame[i].y = vertices[i].y;
+        }
+        return;
+    }
+    
+    int column = index % symmetry->cell_columns;
+    int row = symmetry->cell_row_min + index / symmetry->cell_columns;
+    symmetry_cell_frame(
+        symmetry, symmetry->cell_x + column * symmetry->cell_width, symmetry->cell_y + row * symmetry->cell_height,
+        frame);
+}
+
+/**
+ * Frame holding the fundamental domain: the base triangle (column 0, row 0, pointing right)
+ * or the cell at the origin
+ */
+static void symmetry_base_frame(const Symmetry* symmetry, const LatticeCache* lattice, Point* frame) {
+    if(!symmetry->info->lattice_frames) {
+        symmetry_cell_frame(symmetry, lattice->origin.x, symmetry->cell_y, frame);
+        return;
+    }
+    
+    Point vertices[3];
+    int labels[3];
+    get_triangle_vertices(
+        vertices,
+        lattice->column_x[-lattice->column_min],
+        lattice->column_x[1 - lattice->column_min],
+        &lattice->node_y[-1 - lattice->node_row_min],
+        true);
+    get_vertex_labels(labels, 0, 0, true);
+    for(int i = 0; i < 3; i++) {
+        frame[labels[i]] = vertices[i];
+    }
+}
+
+/**
+ * Set up the frames of a symmetry group for the current lattice
+ *
+ * Cells have even sides, so the midpoints of the cell tables are whole pixels, and are
+ * centered on CENTER_Y like the base triangle before the lattice origin moves them.
+ *
+ * @param symmetry Frames to (re)build
+ * @param group Wallpaper group
+ * @param lattice Lattice cache for the current side length
+ * @return true on success, false if the lattice is empty
+ */
+static bool symmetry_build(Symmetry* symmetry, SymmetryGroup group, const LatticeCache* lattice) {
+    memset(symmetry, 0, sizeof(Symmetry));
+    if(group >= SymmetryCount || lattice->side_length < MIN_SIDE_LENGTH) return false;
+    
+    const SymmetryGroupInfo* info = &symmetry_groups[group];
+    symmetry->info = info;
+    symmetry->group = group;
+    if(info->lattice_frames) {
+        symmetry->frame_count = lattice->triangle_count;
+    } else {
+        symmetry->cell_width = info->cell_aspect * (lattice->side_length + 1);
+        symmetry->cell_height = lattice->side_length + 1;
+        // Also the cells that only reach the screen with their right or bottom edge
+        symmetry->cell_x = lattice->origin.x - symmetry->cell_width;
+        symmetry->cell_y = CENTER_Y - symmetry->cell_height / 2 + lattice->origin.y;
+        symmetry->cell_columns =
+            (SCREEN_WIDTH - symmetry->cell_x + symmetry->cell_width - 1) / symmetry->cell_width;
+        symmetry->cell_row_min = floor_div(-1 - symmetry->cell_y, symmetry->cell_height);
+        int cell_row_max = floor_div(SCREEN_HEIGHT - 1 - symmetry->cell_y, symmetry->cell_height);
+        symmetry->frame_count = symmetry->cell_columns * (cell_row_max - symmetry->cell_row_min + 1);
+    }
+    
+    Point frame[3];
+    Point domain[MAX_DOMAIN_VERTICES];
+    symmetry_base_frame(symmetry, lattice, frame);
+    symmetry_image(info, frame, 0, domain);
+    symmetry->base_sign = (edge_function(domain[0], domain[1], domain[2]) < 0) ? -1 : 1;
+    symmetry->side_length = lattice->side_length;
+    return true;
+}
+
+/**
+ * Wrap a coordinate into [0, period)
+ */
+static int wrap_coordinate(int value, int period) {
+    value %= period;
+    return (value < 0) ? value + period : value;
+}
+
+/**
+ * Translation period of the whole pattern, seeds included, in whole pixels
+ *
+ * The mirror labels of the lattice groups repeat every two columns across and three side
+ * lengths down; cell groups repeat with every cell. Lattice origins stay within one period.
+ * Never wider than the screen, only the lattice groups above a = 21 are taller.
+ */
+static Point pan_period(int side_length, SymmetryGroup group) {
+    const SymmetryGroupInfo* info = &symmetry_groups[group];
+    Point period;
+    if(info->lattice_frames) {
+        const LatticeGeometry* geometry = &lattice_geometry[(side_length - MIN_SIDE_LENGTH) / SIDE_LENGTH_STEP];
+        period.x = lattice_column_x[geometry->column_offset + 2];
+        period.y = 3 * side_length;
+    } else {
+        period.y = side_length + 1;
+        period.x = info->cell_aspect * period.y;
+    }
+    return period;
+}
+
+/**
+ * Lattice origin that shows the pan for the current side length and symmetry group
+ */
+static Point pan_origin(const AppState* state) {
+    Point period = pan_period(state->side_length, state->symmetry_group);
+    Point origin = {
+        .x = wrap_coordinate(state->pan.x, period.x),
+        .y = wrap_coordinate(state->pan.y, period.y),
+    };
+    return origin;
+}
+
+/**
+ * Distance the frames were panned by since the front geometry was built, the shortest way
+ * around the period
+ */
+static Point pan_offset(const AppState* state) {
+    const LatticeCache* lattice = &state->lattice;
+    Point offset = {.x = 0, .y = 0};
+    if(lattice->side_length < MIN_SIDE_LENGTH) return offset;
+    
+    Point period = pan_period(lattice->side_length, state->symmetry.group);
+    offset.x = wrap_coordinate(state->pan.x - lattice->origin.x + period.x / 2, period.x) - period.x / 2;
+    offset.y = wrap_coordinate(state->pan.y - lattice->origin.y + period.y / 2, period.y) - period.y / 2;
+    return offset;
+}
+
+/**
+ * Period the frames of the front geometry repeat with to the pixel, 0 along an axis they
+ * do not
+ *
+ * The lattice tables round every column on its own, so across the lattice groups only repeat
+ * for the side lengths where that adds up, see LatticeCache::columns_repeat. Down they repeat
+ * unless the period is taller than the screen.
+ */
+static Point pan_repeat(const AppState* state) {
+    Point period = pan_period(state->lattice.side_length, state->symmetry.group);
+    if(symmetry_groups[state->symmetry.group].lattice_frames && !state->lattice.columns_repeat) period.x = 0;
+    if(period.y > SCREEN_HEIGHT) period.y = 0;
+    return period;
+}
+
+/**
+ * Check that the frames can show the pan with the front geometry where it is
+ *
+ * Whatever a pan shifts in is on screen one period away along an axis pan_repeat() accepts,
+ * see frame_shift().
+ */
+static bool pan_exact(const AppState* state) {
+    Point offset = pan_offset(state);
+    if(offset.x == 0 && offset.y == 0) return true;
+    Point period = pan_repeat(state);
+    return (offset.x == 0 || period.x != 0) && (offset.y == 0 || period.y != 0);
+}
+
+/**
+ * Set a tile pixel, coordinates are taken modulo the tile size
+ */
+static void tile_set_pixel(Tile* tile, int x, int y) {
+    x = wrap_coordinate(x, tile->width);
+    y = wrap_coordinate(y, tile->height);
+    tile->columns[x] |= (uint64_t)1 << y;
+}
+
+/**
+ * Draw a line into the tile (Bresenham), wrapping around the tile borders
+ */
+static void tile_draw_line(Tile* tile, int x0, int y0, int x1, int y1) {
+    int dx = abs(x1 - x0);
+    int dy = -abs(y1 - y0);
+    int sx = (x0 < x1) ? 1 : -1;
+    int sy = (y0 < y1) ? 1 : -1;
+    int error = dx + dy;
+    
+    while(true) {
+        tile_set_pixel(tile, x0, y0);
+        if(x0 == x1 && y0 == y1) break;
+        int error2 = 2 * error;
+        if(error2 >= dy) {
+            error += dy;
+            x0 += sx;
+        }
+        if(error2 <= dx) {
+            error += dx;
+            y0 += sy;
+        }
+    }
+}
+
+/**
+ * Rasterize the group's mirrors and the domain centroids of one frame into the tile
+ */
+static void tile_draw_frame(
+    Tile* tile,
+    const SymmetryGroupInfo* info,
+    const Point* frame,
+    bool show_lines,
+    bool show_centers) {
+    
+    if(show_lines) {
+        for(int i = 0; i < info->mirror_count; i++) {
+            Point from = symmetry_pixel(symmetry_point(frame, info->mirrors[i][0]));
+            Point to = symmetry_pixel(symmetry_point(frame, info->mirrors[i][1]));
+            tile_draw_line(tile, from.x, from.y, to.x, to.y);
+        }
+    }
+    
+    if(show_centers) {
+        for(int i = 0; i < info->image_count; i++) {
+            Point vertices[MAX_DOMAIN_VERTICES];
+            int count = symmetry_image(info, frame, i, vertices);
+            Point center = symmetry_centroid(vertices, count);
+            tile_set_pixel(tile, center.x, center.y);
+            tile_set_pixel(tile, center.x - 1, center.y);
+            tile_set_pixel(tile, center.x + 1, center.y);
+            tile_set_pixel(tile, center.x, center.y - 1);
+            tile_set_pixel(tile, center.x, center.y + 1);
+        }
+    }
+}
+
+/**
+ * Rasterize one period of the pattern into the tile
+ *
+ * For the lattice groups the cell spans the first two columns and two rows of the lattice:
+ * the base triangle, its mirror image across the apex line and the two triangles above
+ * them. The other groups have a single cell frame. Everything crossing the cell border
+ * wraps around, so the tile is seamless.
+ *
+ * @param tile Tile to fill
+ * @param lattice Lattice cache providing the exact column and node row positions
+ * @param symmetry Frames of the current symmetry group
+ * @param show_lines Rasterize the mirrors
+ * @param show_centers Rasterize the center points
+ */
+static void tile_build(
+    Tile* tile,
+    const LatticeCache* lattice,
+    const Symmetry* symmetry,
+    bool show_lines,
+    bool show_centers) {
+    
+    memset(tile->columns, 0, sizeof(tile->columns));
+    const SymmetryGroupInfo* info = symmetry->info;
+    if(!info->lattice_frames) {
+        Point frame[3];
+        tile->width = symmetry->cell_width;
+        tile->height = symmetry->cell_height;
+        symmetry_base_frame(symmetry, lattice, frame);
+        tile_draw_frame(tile, info, frame, show_lines, show_centers);
+        return;
+    }
+    
+    const int16_t* column_x = &lattice->column_x[-lattice->column_min];
+    tile->width = column_x[2] - column_x[0];
+    tile->height = lattice->side_length;
+    
+    // Node rows -1 .. 2 around the base triangle (row 0)
+    const int16_t* node_y = &lattice->node_y[-1 - lattice->node_row_min];
+    
+    for(int col = 0; col < 2; col++) {
+        int x_left = column_x[col];
+        int x_right = column_x[col + 1];
+        
+        if(show_lines && info->lattice_lines) {
+            for(int y = 0; y < tile->height; y++) {
+                tile_set_pixel(tile, x_left, y);
+            }
+        }
+        
+        for(int row = 0; row < 2; row++) {
+            bool pointing_right = ((col + row) % 2 == 0);
+            Point vertices[3];
+            get_triangle_vertices(vertices, x_left, x_right, &node_y[row], pointing_right);
+            
+            // Diagonals only from right-pointing triangles, like the lattice cache
+            if(show_lines && info->lattice_lines && pointing_right) {
+                tile_draw_line(tile, vertices[0].x, vertices[0].y, vertices[2].x, vertices[2].y);
+                tile_draw_line(tile, vertices[1].x, vertices[1].y, vertices[2].x, vertices[2].y);
+            }
+            
+            Point frame[3];
+            int labels[3];
+            get_vertex_labels(labels, col, row, pointing_right);
+            for(int i = 0; i < 3; i++) {
+                frame[labels[i]] = vertices[i];
+            }
+            tile_draw_frame(tile, info, frame, show_lines, show_centers);
+        }
+    }
+}
+
+/**
+ * Stamp the tile across the whole frame buffer
+ *
+ * Each tile column is repeated vertically with word-wide shifts, split into the frame's
+ * pages, and every page row is then completed by doubling copies of its first tile width.
+ */
+static void tile_stamp(const Tile* tile, uint8_t* frame) {
+    for(int x = 0; x < tile->width && x < SCREEN_WIDTH; x++) {
+        uint64_t column = tile->columns[x];
+        for(int period = tile->height; period < SCREEN_HEIGHT; period *= 2) {
+            column |= column << period;
+        }
+        for(int page = 0; page < FRAME_PAGES; page++) {
+            frame[page * SCREEN_WIDTH + x] = (uint8_t)(column >> (page * 8));
+        }
+    }
+    
+    for(int page = 0; page < FRAME_PAGES; page++) {
+        uint8_t* row = &frame[page * SCREEN_WIDTH];
+        for(int x = tile->width; x < SCREEN_WIDTH;) {
+            int count = MIN(x, SCREEN_WIDTH - x);
+            memcpy(&row[x], row, count);
+            x += count;
+        }
+    }
+}
+
+static FramePixel frame_pixel(int x, int y) {
+    return (FramePixel)((((y >> 3) * SCREEN_WIDTH + x) << 3) | (y & 7));
+}
+
+static void frame_set_pixel(uint8_t* frame, FramePixel pixel) {
+    frame[pixel >> 3] |= (uint8_t)(1 << (pixel & 7));
+}
+
+/**
+ * Drop the orbit table, its memory goes back with the arena it was carved from
+ */
+static void orbit_table_clear(OrbitTable* table) {
+    memset(table, 0, sizeof(OrbitTable));
+}
+
+/**
+ * Build the orbit table for the current lattice and symmetry group
+ *
+ * Every image of the fundamental domain is given by where the reflections move its three
+ * reference points, so a base pixel maps to the point with the same barycentric weights
+ * in that image. The weights are taken in DOMAIN_SCALE units, which keeps the mapping
+ * exact for domains with midpoint and centroid corners.
+ * The table is built in two passes: the first one sizes it, the second one fills it.
+ *
+ * @param table Table to (re)build, previous contents are dropped
+ * @param lattice Lattice cache for the current side length
+ * @param symmetry Frames of the current symmetry group, built for the same lattice
+ * @param arena Arena the table is carved from
+ * @return true on success, false if the arena is exhausted
+ */
+static bool orbit_table_build(
+    OrbitTable* table,
+    const LatticeCache* lattice,
+    const Symmetry* symmetry,
+    Arena* arena) {
+    orbit_table_clear(table);
+    if(lattice->side_length < MIN_SIDE_LENGTH || symmetry->side_length != lattice->side_length) {
+        return false;
+    }
+    const SymmetryGroupInfo* info = symmetry->info;
+    
+    // Fundamental domain, reference points 0..2 define the mapping
+    Point frame[3];
+    Point base[MAX_DOMAIN_VERTICES];
+    symmetry_base_frame(symmetry, lattice, frame);
+    int vertex_count = symmetry_image(info, frame, 0, base);
+    
+    int sign = symmetry->base_sign;
+    int area2 = sign * edge_function(base[0], base[1], base[2]);
+    
+    int x_min = base[0].x;
+    int x_max = base[0].x;
+    int y_min = base[0].y;
+    int y_max = base[0].y;
+    table->base_center.x = 0;
+    table->base_center.y = 0;
+    for(int i = 0; i < vertex_count; i++) {
+        x_min = MIN(x_min, base[i].x);
+        x_max = MAX(x_max, base[i].x);
+        y_min = MIN(y_min, base[i].y);
+        y_max = MAX(y_max, base[i].y);
+        table->base_vertices[i].x = base[i].x * (1 << MOTION_SHIFT) / DOMAIN_SCALE;
+        table->base_vertices[i].y = base[i].y * (1 << MOTION_SHIFT) / DOMAIN_SCALE;
+        table->base_center.x += table->base_vertices[i].x;
+        table->base_center.y += table->base_vertices[i].y;
+    }
+    table->base_center.x /= vertex_count;
+    table->base_center.y /= vertex_count;
+    x_min = floor_div(x_min, DOMAIN_SCALE);
+    x_max = floor_div(x_max, DOMAIN_SCALE);
+    y_min = floor_div(y_min, DOMAIN_SCALE);
+    y_max = floor_div(y_max, DOMAIN_SCALE);
+    
+    table->base_vertex_count = vertex_count;
+    table->base_sign = sign;
+    table->base_x_min = x_min;
+    table->base_columns = MIN(x_max - x_min + 1, MAX_BASE_COLUMNS);
+    
+    for(int pass = 0; pass < 2; pass++) {
+        int base_index = 0;
+        int size = 0;
+        
+        for(int x = x_min; x < x_min + table->base_columns; x++) {
+            if(pass == 1) {
+                table->column_first[x - x_min] = (int16_t)base_index;
+                table->column_y[x - x_min] = 0;
+            }
+            for(int y = y_min; y <= y_max; y++) {
+                Point pixel = {.x = x * DOMAIN_SCALE, .y = y * DOMAIN_SCALE};
+                bool inside = true;
+                for(int i = 0; i < vertex_count && inside; i++) {
+                    inside = sign * edge_function(base[i], base[(i + 1) % vertex_count], pixel) > 0;
+                }
+                if(!inside) continue;
+                int weights[3] = {
+                    sign * edge_function(base[1], base[2], pixel),
+                    sign * edge_function(base[2], base[0], pixel),
+                    sign * edge_function(base[0], base[1], pixel),
+                };
+                
+                if(pass == 1) {
+                    if(table->column_first[x - x_min] == base_index) {
+                        table->column_y[x - x_min] = (int16_t)y;
+                    }
+                    table->orbit_start[base_index] = (uint16_t)size;
+                }
+                
+                for(int f = 0; f < symmetry->frame_count; f++) {
+                    symmetry_frame(symmetry, lattice, f, frame);
+                    for(int image = 0; image < info->image_count; image++) {
+                        Point target[MAX_DOMAIN_VERTICES];
+                        symmetry_image(info, frame, image, target);
+                        int image_x = floor_div(
+                            weights[0] * target[0].x + weights[1] * target[1].x +
+                                weights[2] * target[2].x + area2 * DOMAIN_SCALE / 2,
+                            area2 * DOMAIN_SCALE);
+                        int image_y = floor_div(
+                            weights[0] * target[0].y + weights[1] * target[1].y +
+                                weights[2] * target[2].y + area2 * DOMAIN_SCALE / 2,
+                            area2 * DOMAIN_SCALE);
+                        if(image_x < 0 || image_x >= SCREEN_WIDTH || image_y < 0 ||
+                           image_y >= SCREEN_HEIGHT) {
+                            continue;
+                        }
+                        
+                        if(pass == 1) table->orbit_pixels[size] = frame_pixel(image_x, image_y);
+                        size++;
+                    }
+                }
+                base_index++;
+            }
+        }
+        
+        if(pass == 0) {
+            if(size > UINT16_MAX || base_index > MAX_BASE_PIXELS) return false;
+            table->orbit_start = arena_alloc(arena, sizeof(uint16_t) * (base_index + 1));
+            table->orbit_pixels = arena_alloc(arena, sizeof(FramePixel) * MAX(size, 1));
+            if(table->orbit_start == NULL || table->orbit_pixels == NULL) {
+                orbit_table_clear(table);
+                return false;
+            }
+        } else {
+            table->column_first[table->base_columns] = (int16_t)base_index;
+            table->orbit_start[base_index] = (uint16_t)size;
+            table->base_count = base_index;
+            table->orbit_size = size;
+        }
+    }
+    
+    table->side_length = lattice->side_length;
+    table->group = symmetry->group;
+    return true;
+}
+
+/**
+ * Index of the base pixel at (x, y), -1 if the pixel is not strictly inside the base triangle
+ */
+static int base_pixel_index(const OrbitTable* table, int x, int y) {
+    int column = x - table->base_x_min;
+    if(column < 0 || column >= table->base_columns) return -1;
+    
+    int offset = y - table->column_y[column];
+    int count = table->column_first[column + 1] - table->column_first[column];
+    if(offset < 0 || offset >= count) return -1;
+    return table->column_first[column] + offset;
+}
+
+/**
+ * Coordinates of a base pixel
+ */
+static Point base_pixel_point(const OrbitTable* table, int index) {
+    Point point = {.x = table->base_x_min, .y = 0};
+    for(int column = 0; column < table->base_columns; column++) {
+        if(index < table->column_first[column + 1]) {
+            point.x = table->base_x_min + column;
+            point.y = table->column_y[column] + index - table->column_first[column];
+            break;
+        }
+    }
+    return point;
+}
+
+/**
+ * Fold a Q8 position back into the fundamental domain
+ *
+ * A position beyond an edge is reflected across that mirror, which is exactly what the
+ * kaleidoscope shows there. The velocity is reflected along, so drifting seeds bounce.
+ * The edges are in Q8 as well, their products need 64 bits.
+ */
+static void base_fold(const OrbitTable* table, SeedMotion* motion) {
+    int count = table->base_vertex_count;
+    for(int pass = 0; pass < 3; pass++) {
+        bool inside = true;
+        for(int i = 0; i < count; i++) {
+            // Edge opposite of vertex i for a triangle
+            Point from = table->base_vertices[(i + 1) % count];
+            Point to = table->base_vertices[(i + 2) % count];
+            int64_t ex = to.x - from.x;
+            int64_t ey = to.y - from.y;
+            int64_t dx = motion->x - from.x;
+            int64_t dy = motion->y - from.y;
+            if(table->base_sign * (ex * dy - ey * dx) >= 0) continue;
+            
+            inside = false;
+            int64_t length2 = ex * ex + ey * ey;
+            int64_t along = dx * ex + dy * ey;
+            motion->x = (int32_t)(from.x + 2 * ex * along / length2 - dx);
+            motion->y = (int32_t)(from.y + 2 * ey * along / length2 - dy);
+            int64_t velocity_along = motion->vx * ex + motion->vy * ey;
+            motion->vx = (int32_t)(2 * ex * velocity_along / length2 - motion->vx);
+            motion->vy = (int32_t)(2 * ey * velocity_along / length2 - motion->vy);
+        }
+        if(inside) break;
+    }
+}
+
+/**
+ * Restart the random generator from random_seed
+ *
+ * The seed is scrambled first (murmur3 finalizer), xorshift32 gives poor first values for
+ * small states and has to avoid 0.
+ */
+static void random_reset(AppState* state) {
+    uint32_t x = state->random_seed + 0x9E3779B9U;
+    x = (x ^ (x >> 16)) * 0x85EBCA6BU;
+    x = (x ^ (x >> 13)) * 0xC2B2AE35U;
+    x ^= x >> 16;
+    state->random_state = x ? x : 1;
+}
+
+/**
+ * Next number of the xorshift32 generator
+ */
+static uint32_t random_next(AppState* state) {
+    uint32_t x = state->random_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    state->random_state = x;
+    return x;
+}
+
+/**
+ * Start a seed at its pixel with a random drift velocity
+ */
+static void seed_motion_init(AppState* state, int seed) {
+    Point pixel = base_pixel_point(&state->orbits, state->seeds[seed]);
+    SeedMotion* motion = &state->motion[seed];
+    motion->x = pixel.x << MOTION_SHIFT;
+    motion->y = pixel.y << MOTION_SHIFT;
+    motion->vx = (int32_t)(random_next(state) % (2 * MAX_DRIFT_SPEED + 1)) - MAX_DRIFT_SPEED;
+    motion->vy = (int32_t)(random_next(state) % (2 * MAX_DRIFT_SPEED + 1)) - MAX_DRIFT_SPEED;
+}
+
+/**
+ * Bits set in a word, SWAR: adds neighbouring bit counts in ever wider fields
+ */
+static int popcount32(uint32_t word) {
+    word = word - ((word >> 1) & 0x55555555U);
+    word = (word & 0x33333333U) + ((word >> 2) & 0x33333333U);
+    word = (word + (word >> 4)) & 0x0F0F0F0FU;
+    return (int)((word * 0x01010101U) >> 24);
+}
+
+/**
+ * Add or remove base pixel index in the seed bitmap
+ */
+static void seed_bits_flip(AppState* state, int index) {
+    state->seed_bits[index / 32] ^= (uint32_t)1 << (index % 32);
+}
+
+static bool seed_bits_test(const AppState* state, int index) {
+    return (state->seed_bits[index / 32] >> (index % 32)) & 1;
+}
+
+/**
+ * Number of seed pixels, counted a word at a time over the part of the bitmap in use
+ */
+static int seed_bits_count(const AppState* state) {
+    int count = 0;
+    for(int i = 0; i < (state->orbits.base_count + 31) / 32; i++) {
+        count += popcount32(state->seed_bits[i]);
+    }
+    return count;
+}
+
+/**
+ * Random base pixel that is not a seed yet
+ *
+ * @return base pixel index, -1 if every base pixel is a seed
+ */
+static int seed_pick(AppState* state) {
+    int base_count = state->orbits.base_count;
+    if(state->seed_count >= base_count) return -1;
+    
+    while(true) {
+        int candidate = (int)(random_next(state) % base_count);
+        if(!seed_bits_test(state, candidate)) return candidate;
+    }
+}
+
+/**
+ * Add one random base pixel that is not a seed yet
+ *
+ * @return true if a seed was added, false if the limit or the base triangle is exhausted
+ */
+static bool seed_add(AppState* state) {
+    if(state->seed_count >= MAX_SEEDS) return false;
+    int candidate = seed_pick(state);
+    if(candidate < 0) return false;
+    
+    state->seeds[state->seed_count] = (uint16_t)candidate;
+    seed_bits_flip(state, candidate);
+    seed_motion_init(state, state->seed_count++);
+    return true;
+}
+
+/**
+ * Pick a fresh set of seeds for the current orbit table, keeping their number if possible
+ *
+ * The generator restarts from random_seed, so seed, side length and count give the same
+ * pattern every time.
+ */
+static void seeds_regenerate(AppState* state) {
+    int count = state->seed_count;
+    state->seed_count = 0;
+    memset(state->seed_bits, 0, sizeof(state->seed_bits));
+    random_reset(state);
+    while(state->seed_count < count && seed_add(state)) {
+    }
+}
+
+static void frame_xor_pixel(uint8_t* frame, FramePixel pixel) {
+    frame[pixel >> 3] ^= (uint8_t)(1 << (pixel & 7));
+}
+
+/**
+ * Set a pixel given by coordinates, pixels off screen are ignored
+ */
+static void frame_draw_dot(uint8_t* frame, int x, int y) {
+    if(x < 0 || x >= SCREEN_WIDTH || y < 0 || y >= SCREEN_HEIGHT) return;
+    frame_set_pixel(frame, frame_pixel(x, y));
+}
+
+/**
+ * Draw a full-height vertical line: one byte per page
+ */
+static void frame_draw_vline(uint8_t* frame, int x) {
+    if(x < 0 || x >= SCREEN_WIDTH) return;
+    for(int page = 0; page < FRAME_PAGES; page++) {
+        frame[page * SCREEN_WIDTH + x] = 0xFF;
+    }
+}
+
+/**
+ * Draw a line (Bresenham), clipped to the screen
+ */
+static void frame_draw_line(uint8_t* frame, int x0, int y0, int x1, int y1) {
+    int dx = abs(x1 - x0);
+    int dy = -abs(y1 - y0);
+    int sx = (x0 < x1) ? 1 : -1;
+    int sy = (y0 < y1) ? 1 : -1;
+    int error = dx + dy;
+    
+    while(true) {
+        frame_draw_dot(frame, x0, y0);
+        if(x0 == x1 && y0 == y1) break;
+        int error2 = 2 * error;
+        if(error2 >= dy) {
+            error += dy;
+            x0 += sx;
+        }
+        if(error2 <= dx) {
+            error += dx;
+            y0 += sy;
+        }
+    }
+}
+
+/**
+ * Draw a cached diagonal by replaying its step pattern
+ *
+ * Lines that are entirely on screen walk the frame with a byte pointer and a bit mask; every
+ * pixel is one OR, a step moves the mask and crosses into the next page when it runs out.
+ */
+static void frame_draw_diagonal(uint8_t* frame, const LatticeCache* lattice, const DiagonalLine* line) {
+    if(line->pattern == NO_DIAGONAL_PATTERN) {
+        frame_draw_line(frame, line->from.x, line->from.y, line->to.x, line->to.y);
+        return;
+    }
+    
+    const DiagonalPattern* pattern = &lattice->patterns[line->pattern];
+    bool down = line->to.y > line->from.y;
+    int x = line->from.x;
+    int y = line->from.y;
+    
+    if(!line->inside) {
+        for(int i = 0; i <= pattern->run; i++, x++) {
+            if(x >= 0 && x < SCREEN_WIDTH && y >= 0 && y < SCREEN_HEIGHT) {
+                frame[(y / 8) * SCREEN_WIDTH + x] |= (uint8_t)(1 << (y % 8));
+            }
+            if(pattern->steps[i]) y += down ? 1 : -1;
+        }
+        return;
+    }
+    
+    uint8_t* byte = &frame[(y / 8) * SCREEN_WIDTH + x];
+    uint8_t mask = (uint8_t)(1 << (y % 8));
+    for(int i = 0; i <= pattern->run; i++, byte++) {
+        *byte |= mask;
+        if(!pattern->steps[i]) continue;
+        if(down) {
+            mask <<= 1;
+            if(mask == 0) {
+                mask = 0x01;
+                byte += SCREEN_WIDTH;
+            }
+        } else {
+            mask >>= 1;
+            if(mask == 0) {
+                mask = 0x80;
+                byte -= SCREEN_WIDTH;
+            }
+        }
+    }
+}
+
+/**
+ * Fill the pixels y0..y1 of column x, whole bytes where the span covers a full page
+ */
+static void frame_fill_span(uint8_t* frame, int x, int y0, int y1) {
+    if(x < 0 || x >= SCREEN_WIDTH) return;
+    y0 = MAX(y0, 0);
+    y1 = MIN(y1, SCREEN_HEIGHT - 1);
+    if(y0 > y1) return;
+    
+    uint8_t* byte = &frame[(y0 / 8) * SCREEN_WIDTH + x];
+    uint8_t first = (uint8_t)(0xFF << (y0 % 8));
+    uint8_t last = (uint8_t)(0xFF >> (7 - y1 % 8));
+    int pages = y1 / 8 - y0 / 8;
+    if(pages == 0) {
+        *byte |= first & last;
+        return;
+    }
+    
+    *byte |= first;
+    for(int page = 1; page < pages; page++) {
+        byte += SCREEN_WIDTH;
+        *byte = 0xFF;
+    }
+    byte[SCREEN_WIDTH] |= last;
+}
+
+/**
+ * Fill every right-pointing triangle with column spans
+ *
+ * The spans run from the upper to the lower diagonal of each triangle, both stepped with
+ * their cached patterns, so the fill meets the lines exactly. In the page layout of the
+ * frame a vertical span is a handful of byte writes, where a horizontal one would be one
+ * read-modify-write per pixel.
+ */
+static void frame_fill_triangles(uint8_t* frame, const LatticeCache* lattice) {
+    for(int i = 0; i + 1 < lattice->diagonal_count; i += 2) {
+        const DiagonalLine* upper = &lattice->diagonals[i];
+        const DiagonalLine* lower = &lattice->diagonals[i + 1];
+        // Every extent of the supported side lengths has a pattern
+        if(upper->pattern == NO_DIAGONAL_PATTERN || lower->pattern == NO_DIAGONAL_PATTERN) continue;
+        
+        const DiagonalPattern* upper_steps = &lattice->patterns[upper->pattern];
+        const DiagonalPattern* lower_steps = &lattice->patterns[lower->pattern];
+        if(upper->from.x >= SCREEN_WIDTH || upper->from.y >= SCREEN_HEIGHT || lower->from.y < 0) continue;
+        
+        int x = upper->from.x;
+        int y_top = upper->from.y;
+        int y_bottom = lower->from.y;
+        for(int step = 0; step <= upper_steps->run; step++, x++) {
+            frame_fill_span(frame, x, y_top, y_bottom);
+            y_top += upper_steps->steps[step];
+            y_bottom -= lower_steps->steps[step];
+        }
+    }
+}
+
+/**
+ * Draw a center point: a disc of radius 1
+ */
+static void frame_draw_center(uint8_t* frame, int x, int y) {
+    frame_draw_dot(frame, x, y);
+    frame_draw_dot(frame, x - 1, y);
+    frame_draw_dot(frame, x + 1, y);
+    frame_draw_dot(frame, x, y - 1);
+    frame_draw_dot(frame, x, y + 1);
+}
+
+/**
+ * Fill a convex domain image given in DOMAIN_SCALE units, edges included
+ *
+ * Every edge bounds the column from above or below, so each column is one span between
+ * the tightest bounds, like frame_fill_triangles() does for the lattice triangles.
+ */
+static void frame_fill_domain(uint8_t* frame, const Point* vertices, int count, int sign) {
+    int x_min = vertices[0].x;
+    int x_max = vertices[0].x;
+    for(int i = 1; i < count; i++) {
+        x_min = MIN(x_min, vertices[i].x);
+        x_max = MAX(x_max, vertices[i].x);
+    }
+    x_min = MAX(ceil_div(x_min, DOMAIN_SCALE), 0);
+    x_max = MIN(floor_div(x_max, DOMAIN_SCALE), SCREEN_WIDTH - 1);
+    
+    for(int x = x_min; x <= x_max; x++) {
+        int y_top = 0;
+        int y_bottom = SCREEN_HEIGHT - 1;
+        for(int i = 0; i < count; i++) {
+            Point from = vertices[i];
+            Point to = vertices[(i + 1) % count];
+            // Inside: run * (y * DOMAIN_SCALE - from.y) >= rise
+            int run = sign * (to.x - from.x);
+            int rise = sign * (to.y - from.y) * (x * DOMAIN_SCALE - from.x);
+            if(run > 0) {
+                y_top = MAX(y_top, ceil_div(run * from.y + rise, run * DOMAIN_SCALE));
+            } else if(run < 0) {
+                y_bottom = MIN(y_bottom, floor_div(-run * from.y - rise, -run * DOMAIN_SCALE));
+            } else if(rise > 0) {
+                y_bottom = -1;
+            }
+        }
+        frame_fill_span(frame, x, y_top, y_bottom);
+    }
+}
+
+// Parts of the domain images drawn by frame_draw_domains()
+typedef enum {
+    DomainLayerFill, // Images oriented like the fundamental domain
+    DomainLayerMirrors, // Mirrors of the group besides the lattice lines
+    DomainLayerCenters, // Centroids of all images
+} DomainLayer;
+
+/**
+ * Draw one layer of the domain images of every frame
+ *
+ * Covers what the lattice cache has no counterpart for: the extra mirrors of p6m and the
+ * fill and centers of every group whose domains are not the lattice triangles.
+ */
+static void frame_draw_domains(
+    uint8_t* frame,
+    const LatticeCache* lattice,
+    const Symmetry* symmetry,
+    DomainLayer layer) {
+    
+    const SymmetryGroupInfo* info = symmetry->info;
+    if(layer == DomainLayerMirrors && info->mirror_count == 0) return;
+    
+    for(int f = 0; f < symmetry->frame_count; f++) {
+        Point points[3];
+        symmetry_frame(symmetry, lattice, f, points);
+        
+        if(layer == DomainLayerMirrors) {
+            for(int i = 0; i < info->mirror_count; i++) {
+                Point from = symmetry_pixel(symmetry_point(points, info->mirrors[i][0]));
+                Point to = symmetry_pixel(symmetry_point(points, info->mirrors[i][1]));
+                frame_draw_line(frame, from.x, from.y, to.x, to.y);
+            }
+            continue;
+        }
+        
+        for(int image = 0; image < info->image_count; image++) {
+            Point vertices[MAX_DOMAIN_VERTICES];
+            int count = symmetry_image(info, points, image, vertices);
+            if(layer == DomainLayerCenters) {
+                Point center = symmetry_centroid(vertices, count);
+                frame_draw_center(frame, center.x, center.y);
+            } else if(symmetry->base_sign * edge_function(vertices[0], vertices[1], vertices[2]) > 0) {
+                frame_fill_domain(frame, vertices, count, symmetry->base_sign);
+            }
+        }
+    }
+}
+
+/**
+ * Build a lattice, its symmetry frames and orbit table for a side length, symmetry group and
+ * lattice origin
+ *
+ * Whatever the arena held before is given back first, so it must only hold this geometry.
+ *
+ * @return true on success, false if the arena is exhausted
+ */
+static bool geometry_build_into(
+    LatticeCache* lattice,
+    Symmetry* symmetry,
+    OrbitTable* orbits,
+    Arena* arena,
+    int side_length,
+    SymmetryGroup group,
+    Point origin) {
+    lattice_cache_clear(lattice);
+    orbit_table_clear(orbits);
+    arena_reset(arena);
+    return lattice_cache_build(lattice, side_length, origin, arena) && symmetry_build(symmetry, group, lattice) &&
+           orbit_table_build(orbits, lattice, symmetry, arena);
+}
+
+/**
+ * Build the lattice, the symmetry frames and the orbit table for the current side length,
+ * symmetry group and pan
+ *
+ * @return true on success, false if memory could not be allocated
+ */
+static bool geometry_build(AppState* state) {
+    // Every layer the render worker holds was drawn against the old geometry
+    state->layers_dirty = RenderLayerAll;
+    return geometry_build_into(
+        &state->lattice, &state->symmetry, &state->orbits, &state->geometry_arena, state->side_length,
+        state->symmetry_group, pan_origin(state));
+}
+
+/**
+ * Toggle the mirror orbit of one seed in the frame
+ *
+ * Seeds are combined with XOR, so adding and removing a seed is the same operation and
+ * leaves the lines and center points underneath untouched.
+ */
+static void frame_toggle_seed(uint8_t* frame, const OrbitTable* orbits, int seed) {
+    for(int i = orbits->orbit_start[seed]; i < orbits->orbit_start[seed + 1]; i++) {
+        frame_xor_pixel(frame, orbits->orbit_pixels[i]);
+    }
+}
+
+/**
+ * Toggle the mirror orbit of one seed in a frame panned by offset from the geometry
+ *
+ * The frame repeats with the period, see pan_repeat(), so the orbit pixels of the first
+ * period are moved by the offset and repeated across the screen.
+ */
+static void frame_toggle_seed_panned(uint8_t* frame, const OrbitTable* orbits, int seed, Point offset, Point period) {
+    int width = MIN(period.x, SCREEN_WIDTH);
+    int height = MIN(period.y, SCREEN_HEIGHT);
+    for(int i = orbits->orbit_start[seed]; i < orbits->orbit_start[seed + 1]; i++) {
+        int byte = orbits->orbit_pixels[i] >> 3;
+        int x = byte % SCREEN_WIDTH;
+        int y = (byte / SCREEN_WIDTH) * 8 + (orbits->orbit_pixels[i] & 7);
+        if(x >= width || y >= height) continue;
+        
+        for(int screen_y = wrap_coordinate(y + offset.y, period.y); screen_y < SCREEN_HEIGHT; screen_y += period.y) {
+            for(int screen_x = wrap_coordinate(x + offset.x, period.x); screen_x < SCREEN_WIDTH;
+                screen_x += period.x) {
+                frame_xor_pixel(frame, frame_pixel(screen_x, screen_y));
+            }
+        }
+    }
+}
+
+/**
+ * Number of bitplanes seed slot i is drawn in, the seeds cycle through the gray levels
+ */
+static int seed_level(int seed, int planes) {
+    return 1 + seed % planes;
+}
+
+/**
+ * Frame buffer of a bitplane, plane 0 is the black and white frame
+ */
+static uint8_t* plane_frame(AppState* state, int plane) {
+    return (plane == 0) ? state->frame : state->gray_frames[plane - 1];
+}
+
+/**
+ * Draw the seeds that show in one bitplane by walking their mirror orbits
+ */
+static void draw_seeds(uint8_t* frame, const RenderJob* job, int plane) {
+    const OrbitTable* orbits = job->orbits;
+    if(orbits->side_length != job->lattice->side_length) return;
+    
+    for(int i = 0; i < job->seed_count; i++) {
+        if(seed_level(i, job->gray_planes) > plane) frame_toggle_seed(frame, orbits, job->seeds[i]);
+    }
+}
+
+/**
+ * Toggle base pixel index as seed slot seed in every bitplane it shows in
+ */
+static void seed_toggle(AppState* state, int seed, int index) {
+    if(!pan_exact(state)) {
+        // The strips panned in are not the pattern yet, the rebuild renders them
+        state->frame_dirty = true;
+        return;
+    }
+    Point offset = pan_offset(state);
+    Point period = pan_repeat(state);
+    // An axis that was not panned along repeats with the screen
+    if(offset.x == 0) period.x = SCREEN_WIDTH;
+    if(offset.y == 0) period.y = SCREEN_HEIGHT;
+    int level = seed_level(seed, state->frame_planes);
+    for(int plane = 0; plane < level; plane++) {
+        if(offset.x != 0 || offset.y != 0) {
+            frame_toggle_seed_panned(plane_frame(state, plane), &state->orbits, index, offset, period);
+        } else {
+            frame_toggle_seed(plane_frame(state, plane), &state->orbits, index);
+        }
+    }
+}
+
+/**
+ * Move a seed to another base pixel, updating the frame incrementally
+ */
+static void seed_move(AppState* state, int seed, int index) {
+    if(index < 0 || index == state->seeds[seed]) return;
+    seed_toggle(state, seed, state->seeds[seed]);
+    seed_toggle(state, seed, index);
+    seed_bits_flip(state, state->seeds[seed]);
+    seed_bits_flip(state, index);
+    state->seeds[seed] = (uint16_t)index;
+}
+
+/**
+ * Rotate a column of the pattern by rotate rows within one period of height rows and repeat
+ * the period down the screen, rows from height on are dropped first
+ */
+static uint64_t column_repeat(uint64_t column, int height, int rotate) {
+    uint64_t mask = (height < 64) ? ((uint64_t)1 << height) - 1 : ~(uint64_t)0;
+    column &= mask;
+    if(rotate != 0) {
+        column = ((column << rotate) | (column >> (height - rotate))) & mask;
+    }
+    for(int period = height; period < SCREEN_HEIGHT; period *= 2) {
+        column |= column << period;
+    }
+    return column;
+}
+
+/**
+ * Screen column x of the pattern the tile holds, shifted by shift from where it was built
+ */
+static uint64_t tile_screen_column(const Tile* tile, int x, Point shift) {
+    uint64_t column = tile->columns[wrap_coordinate(x - shift.x, tile->width)];
+    return column_repeat(column, tile->height, wrap_coordinate(shift.y, tile->height));
+}
+
+/**
+ * Reverse count bytes in place
+ */
+static void bytes_reverse(uint8_t* bytes, int count) {
+    for(int i = 0, j = count - 1; i < j; i++, j--) {
+        uint8_t byte = bytes[i];
+        bytes[i] = bytes[j];
+        bytes[j] = byte;
+    }
+}
+
+/**
+ * Shift a frame buffer by whole pixels
+ *
+ * Along an axis the pattern repeats on, what is shifted in is on screen already one period
+ * away: columns are rotated within the first period of every page, which is then copied
+ * across the rest, rows the same within every column. Fill, seeds and all move just as they
+ * were rendered. Along an axis without a period columns move as whole bytes and rows as bits,
+ * and the strips shifted in get lines and center points from the tile; the geometry is
+ * rebuilt at the new origin then. Rows are gathered from the pages of a column into one word.
+ *
+ * @param frame Frame buffer to shift
+ * @param dx Pixels to move right, negative to the left
+ * @param dy Pixels to move down, negative up
+ * @param period Period of the frame, see pan_repeat()
+ * @param tile Tile rasterized at the lattice origin, for an axis without a period
+ * @param shift Offset of the shifted frame from the lattice origin
+ */
+static void frame_shift(uint8_t* frame, int dx, int dy, Point period, const Tile* tile, Point shift) {
+    int strip_start = 0;
+    int strip_end = 0;
+    if(dx != 0 && period.x != 0) {
+        int rotate = wrap_coordinate(dx, period.x);
+        for(int page = 0; page < FRAME_PAGES && rotate != 0; page++) {
+            uint8_t* row = &frame[page * SCREEN_WIDTH];
+            // Right by rotate: the whole period reversed, then both parts
+            bytes_reverse(row, period.x);
+            bytes_reverse(row, rotate);
+            bytes_reverse(&row[rotate], period.x - rotate);
+            for(int x = period.x; x < SCREEN_WIDTH;) {
+                int count = MIN(x, SCREEN_WIDTH - x);
+                memcpy(&row[x], row, count);
+                x += count;
+            }
+        }
+    } else if(dx != 0) {
+        dx = CLAMP(dx, SCREEN_WIDTH, -SCREEN_WIDTH);
+        int count = SCREEN_WIDTH - abs(dx);
+        for(int page = 0; page < FRAME_PAGES; page++) {
+            uint8_t* row = &frame[page * SCREEN_WIDTH];
+            if(dx > 0) {
+                memmove(&row[dx], row, count);
+            } else {
+                memmove(row, &row[-dx], count);
+            }
+        }
+        strip_start = (dx > 0) ? 0 : SCREEN_WIDTH + dx;
+        strip_end = (dx > 0) ? dx : SCREEN_WIDTH;
+    }
+    
+    // Rows shifted in, a shift by the screen height or more leaves none of the old ones
+    bool rows_kept = abs(dy) < SCREEN_HEIGHT;
+    uint64_t rows_new = 0;
+    if(dy > 0 && rows_kept) rows_new = ((uint64_t)1 << dy) - 1;
+    if(dy < 0 && rows_kept) rows_new = ~(~(uint64_t)0 >> -dy);
+    
+    for(int x = 0; x < SCREEN_WIDTH; x++) {
+        bool in_strip = x >= strip_start && x < strip_end;
+        if(!in_strip && dy == 0) continue;
+        
+        uint64_t kept = 0;
+        for(int page = 0; page < FRAME_PAGES && !in_strip; page++) {
+            kept |= (uint64_t)frame[page * SCREEN_WIDTH + x] << (page * 8);
+        }
+        uint64_t column;
+        if(!in_strip && period.y != 0) {
+            column = column_repeat(kept, period.y, wrap_coordinate(dy, period.y));
+        } else {
+            column = tile_screen_column(tile, x, shift);
+            if(!in_strip && rows_kept) {
+                kept = (dy > 0) ? kept << dy : kept >> -dy;
+                column = (kept & ~rows_new) | (column & rows_new);
+            }
+        }
+        for(int page = 0; page < FRAME_PAGES; page++) {
+            frame[page * SCREEN_WIDTH + x] = (uint8_t)(column >> (page * 8));
+        }
+    }
+}
+
+/**
+ * Shift every bitplane by the pan that was just added
+ */
+static void frames_shift(AppState* state, int dx, int dy) {
+    Point period = pan_repeat(state);
+    if((dx != 0 && period.x == 0) || (dy != 0 && period.y == 0)) {
+        tile_build(&state->tile, &state->lattice, &state->symmetry, state->show_lines, state->show_info);
+        // Also when the pan ends up a whole period away, which needs no rebuild
+        state->frame_dirty = true;
+    }
+    Point shift = pan_offset(state);
+    for(int plane = 0; plane < state->frame_planes; plane++) {
+        frame_shift(plane_frame(state, plane), dx, dy, period, &state->tile, shift);
+    }
+}
+
+/**
+ * Pan the pattern, the frames are shifted right away
+ *
+ * The front geometry stays where it was built as long as pan_exact() holds, otherwise the
+ * render worker catches up with a geometry at the new origin.
+ *
+ * @return true if the frame changed
+ */
+static bool pan_move(AppState* state, int dx, int dy) {
+    state->pan.x += dx;
+    state->pan.y += dy;
+    if(state->frame_stale || state->lattice.side_length < MIN_SIDE_LENGTH) {
+        state->frame_dirty = true;
+        return false;
+    }
+    frames_shift(state, dx, dy);
+    return true;
+}
+
+/**
+ * Pixels panned per animation tick
+ */
+static int pan_step(const AppState* state) {
+    return MAX(1, PAN_SPEED / state->animation_fps);
+}
+
+/**
+ * Mark layers to be drawn again, the next frame job composes every bitplane from them
+ */
+static void layers_invalidate(AppState* state, uint8_t layers) {
+    state->layers_dirty |= layers;
+    state->frame_dirty = true;
+}
+
+/**
+ * Advance the animation by one frame
+ *
+ * Seeds are moved with sub-pixel precision and folded back into the base triangle; only
+ * seeds that land on a different pixel touch the frame.
+ *
+ * @return true if the frame changed
+ */
+static bool animation_step(AppState* state) {
+    if(state->animation_mode == AnimationScroll) {
+        int step = pan_step(state);
+        return pan_move(state, step, step);
+    }
+    
+    const OrbitTable* orbits = &state->orbits;
+    if(state->seed_count == 0 || orbits->side_length != state->side_length) return false;
+    
+    bool changed = false;
+    
+    if(state->animation_mode == AnimationRegenerate) {
+        int seed = state->regenerate_next % state->seed_count;
+        int replacement = seed_pick(state);
+        if(replacement >= 0) {
+            seed_move(state, seed, replacement);
+            changed = true;
+        }
+        state->regenerate_next = seed + 1;
+        return changed;
+    }
+    
+    // Centroid of the fundamental domain for the rotation
+    int32_t center_x = orbits->base_center.x;
+    int32_t center_y = orbits->base_center.y;
+    
+    for(int i = 0; i < state->seed_count; i++) {
+        SeedMotion* motion = &state->motion[i];
+        
+        if(state->animation_mode == AnimationDrift) {
+            motion->x += motion->vx;
+            motion->y += motion->vy;
+        } else if(state->animation_mode == AnimationRotate) {
+            // Rounded, a truncating shift would pull every seed towards the center
+            int64_t dx = motion->x - center_x;
+            int64_t dy = motion->y - center_y;
+            int64_t half = 1LL << (ROTATION_SHIFT - 1);
+            motion->x = center_x + (int32_t)((dx * ROTATION_COS_Q30 - dy * ROTATION_SIN_Q30 + half) >> ROTATION_SHIFT);
+            motion->y = center_y + (int32_t)((dx * ROTATION_SIN_Q30 + dy * ROTATION_COS_Q30 + half) >> ROTATION_SHIFT);
+        } else {
+            return false;
+        }
+        base_fold(orbits, motion);
+        
+        int half = 1 << (MOTION_SHIFT - 1);
+        int index = base_pixel_index(
+            orbits, (motion->x + half) >> MOTION_SHIFT, (motion->y + half) >> MOTION_SHIFT);
+        if(index >= 0 && index != state->seeds[i]) {
+            seed_move(state, i, index);
+            changed = true;
+        }
+    }
+    
+    return changed;
+}
+
+/**
+ * Draw a full-width horizontal line: one OR per column
+ */
+static void frame_draw_hline(uint8_t* frame, int y) {
+    if(y < 0 || y >= SCREEN_HEIGHT) return;
+    uint8_t* row = &frame[(y / 8) * SCREEN_WIDTH];
+    uint8_t mask = (uint8_t)(1 << (y % 8));
+    for(int x = 0; x < SCREEN_WIDTH; x++) {
+        row[x] |= mask;
+    }
+}
+
+/**
+ * Draw a lattice diagonal across the screen, only the columns where it is on screen
+ *
+ * @param y_q16 y at x = 0
+ * @param slope_q16 y change per column, less than one pixel
+ */
+static void frame_draw_slope(uint8_t* frame, int32_t y_q16, int32_t slope_q16) {
+    int32_t top = 0;
+    int32_t bottom = (SCREEN_HEIGHT << FIXED_SHIFT) - 1;
+    int32_t rise = slope_q16 * (SCREEN_WIDTH - 1);
+    int32_t y1_q16 = y_q16 + rise;
+    if(MAX(y_q16, y1_q16) < top || MIN(y_q16, y1_q16) > bottom) return;
+    
+    int x_start = 0;
+    int x_end = SCREEN_WIDTH - 1;
+    if(slope_q16 > 0) {
+        if(y_q16 < top) x_start = ceil_div(top - y_q16, slope_q16);
+        if(y1_q16 > bottom) x_end = floor_div(bottom - y_q16, slope_q16);
+    } else {
+        if(y_q16 > bottom) x_start = ceil_div(y_q16 - bottom, -slope_q16);
+        if(y1_q16 < top) x_end = floor_div(y_q16 - top, -slope_q16);
+    }
+    
+    int32_t y = y_q16 + slope_q16 * x_start + (1 << (FIXED_SHIFT - 1));
+    for(int x = x_start; x <= x_end; x++, y += slope_q16) {
+        frame_draw_dot(frame, x, y >> FIXED_SHIFT);
+    }
+}
+
+/**
+ * Draw the lattice or cell lines of the zoom preview
+ *
+ * Every line spans the screen, so the work is one pass per visible line whatever the
+ * triangle count. Seeds, centers and the mirrors inside the domains are left out until the
+ * zoom stops and the geometry for the new side length is built.
+ *
+ * @param origin Lattice origin, see pan_origin(), the lines move with the pan
+ */
+static void frame_draw_zoom(uint8_t* frame, const Zoom* zoom, const SymmetryGroupInfo* info, Point origin) {
+    memset(frame, 0, FRAME_SIZE);
+    int32_t origin_x_q16 = origin.x << FIXED_SHIFT;
+    
+    if(info->lattice_lines) {
+        int32_t column_q16 = zoom->column_q16;
+        int32_t x_first_q16 = origin_x_q16 - floor_div(origin_x_q16, column_q16) * column_q16;
+        for(int32_t x_q16 = x_first_q16; (x_q16 >> FIXED_SHIFT) < SCREEN_WIDTH; x_q16 += column_q16) {
+            frame_draw_vline(frame, x_q16 >> FIXED_SHIFT);
+        }
+        
+        // Both diagonal families run through the nodes on x = origin.x, which sit half a side
+        // length off the origin row and repeat every side length
+        int32_t rise = DIAGONAL_SLOPE_Q16 * (SCREEN_WIDTH - 1);
+        int32_t node_q16 = ((CENTER_Y + origin.y) << FIXED_SHIFT) + zoom->side_q16 / 2;
+        for(int sign = -1; sign <= 1; sign += 2) {
+            int32_t slope_q16 = sign * DIAGONAL_SLOPE_Q16;
+            int32_t first_q16 = node_q16 - slope_q16 * origin.x; // Where the line through the node meets x = 0
+            int32_t low = -rise - first_q16;
+            int32_t high = (SCREEN_HEIGHT << FIXED_SHIFT) + rise - first_q16;
+            for(int i = ceil_div(low, zoom->side_q16); i <= floor_div(high, zoom->side_q16); i++) {
+                frame_draw_slope(frame, first_q16 + i * zoom->side_q16, slope_q16);
+            }
+        }
+        return;
+    }
+    
+    // Cells like symmetry_build(): side length + 1 high, cell_aspect times that wide
+    int32_t height_q16 = zoom->side_q16 + (1 << FIXED_SHIFT);
+    int32_t width_q16 = height_q16 * info->cell_aspect;
+    int32_t x_first_q16 = origin_x_q16 - floor_div(origin_x_q16, width_q16) * width_q16;
+    for(int32_t x_q16 = x_first_q16; (x_q16 >> FIXED_SHIFT) < SCREEN_WIDTH; x_q16 += width_q16) {
+        frame_draw_vline(frame, x_q16 >> FIXED_SHIFT);
+    }
+    int32_t cell_y_q16 = ((CENTER_Y + origin.y) << FIXED_SHIFT) - height_q16 / 2;
+    int first = floor_div(-cell_y_q16, height_q16);
+    for(int i = first; cell_y_q16 + i * height_q16 < (SCREEN_HEIGHT << FIXED_SHIFT); i++) {
+        frame_draw_hline(frame, (cell_y_q16 + i * height_q16) >> FIXED_SHIFT);
+    }
+}
+
+/**
+ * Start zooming from the current side length, the animation timer drives the steps
+ */
+static void zoom_start(AppState* state, int direction) {
+    Zoom* zoom = &state->zoom;
+    if(zoom->direction == 0) {
+        zoom->side_q16 = state->side_length << FIXED_SHIFT;
+        zoom->column_q16 = state->side_length * SQRT3_HALF_Q16;
+        zoom->side_step_q16 = (ZOOM_SPEED << FIXED_SHIFT) / state->animation_fps;
+        zoom->column_step_q16 = (int32_t)(((int64_t)zoom->side_step_q16 * SQRT3_HALF_Q16) >> FIXED_SHIFT);
+    }
+    zoom->direction = direction;
+}
+
+/**
+ * Advance the zoom by one tick and draw the preview into every bitplane
+ *
+ * @return true if the frame changed, false at the end of the side length range
+ */
+static bool zoom_step(AppState* state) {
+    Zoom* zoom = &state->zoom;
+    int32_t side_q16 = zoom->side_q16 + zoom->direction * zoom->side_step_q16;
+    if(side_q16 < (MIN_SIDE_LENGTH << FIXED_SHIFT) || side_q16 > (MAX_SIDE_LENGTH << FIXED_SHIFT)) return false;
+    zoom->side_q16 = side_q16;
+    zoom->column_q16 += zoom->direction * zoom->column_step_q16;
+    
+    // The preview does not depend on the geometry, a rebuild that finished meanwhile is no reason to hold it back
+    state->frame_stale = false;
+    Point origin = pan_origin(state);
+    for(int plane = 0; plane < state->frame_planes; plane++) {
+        frame_draw_zoom(plane_frame(state, plane), zoom, &symmetry_groups[state->symmetry_group], origin);
+    }
+    return true;
+}
+
+/**
+ * Side length of the table nearest to the zoom, at least one step from where it started
+ */
+static int zoom_side_length(const AppState* state) {
+    const Zoom* zoom = &state->zoom;
+    int step_q16 = SIDE_LENGTH_STEP << FIXED_SHIFT;
+    int steps = (zoom->side_q16 - (MIN_SIDE_LENGTH << FIXED_SHIFT) + step_q16 / 2) / step_q16;
+    int side_length = MIN_SIDE_LENGTH + steps * SIDE_LENGTH_STEP;
+    // A short press steps like the step mode
+    if(side_length == state->side_length) side_length += zoom->direction * SIDE_LENGTH_STEP;
+    return CLAMP(side_length, MAX_SIDE_LENGTH, MIN_SIDE_LENGTH);
+}
+
+/**
+ * Stop zooming and settle on the nearest side length, the worker builds its geometry
+ */
+static void zoom_stop(AppState* state) {
+    state->side_length = zoom_side_length(state);
+    state->zoom.direction = 0;
+    state->frame_dirty = true;
+}
+
+/**
+ * Start, restart or stop the animation timer to match the animation settings
+ *
+ * The timer also paces the smooth zoom and held pan keys. It is only touched when its period
+ * changes: starting it again on every key repeat would keep pushing the next tick out, and at
+ * low rates no tick would come while a key is held.
+ */
+static void animation_timer_update(AppState* state) {
+    bool panning = state->pan_direction.x != 0 || state->pan_direction.y != 0;
+    uint32_t period = 0;
+    if(state->animation_mode != AnimationOff || state->zoom.direction != 0 || panning) {
+        period = furi_ms_to_ticks(1000 / state->animation_fps);
+    }
+    if(period == state->animation_period) return;
+    
+    state->animation_period = period;
+    if(period) {
+        furi_timer_start(state->animation_timer, period);
+    } else {
+        furi_timer_stop(state->animation_timer);
+    }
+}
+
+/**
+ * Start or stop cycling through the bitplanes
+ *
+ * The timer only drives the view port. While the direct draw canvas is held every frame the
+ * main loop commits shows the next plane instead, see frame_show().
+ */
+static void gray_timer_update(AppState* state) {
+    if(state->gray_planes > 1 && state->direct_canvas == NULL) {
+        if(!furi_timer_is_running(state->gray_timer)) {
+            furi_timer_start(state->gray_timer, furi_ms_to_ticks(GRAY_FLIP_MS));
+        }
+    } else if(furi_timer_is_running(state->gray_timer)) {
+        furi_timer_stop(state->gray_timer);
+    }
+}
+
+static const char* const render_mode_names[RenderModeCount] = {"lattice", "tile", "filled"};
+static const char* const animation_mode_names[AnimationCount] = {"off", "drift", "rotate", "regen", "scroll"};
+static const char* const menu_item_names[MenuItemCount] = {"Render", "Group", "Anim", "FPS", "Draw", "Gray", "Zoom", "Arrows", "Seed", "Export"};
+static const char* const export_format_names[ExportFormatCount] = {"pbm", "rle"};
+
+/**
+ * Pack a frame into PBM raster order: rows top to bottom, 8 pixels per byte, MSB left
+ */
+static void export_pack_rows(uint8_t* out, const uint8_t* frame) {
+    for(int y = 0; y < SCREEN_HEIGHT; y++) {
+        const uint8_t* page = &frame[(y / 8) * SCREEN_WIDTH];
+        uint8_t bit = (uint8_t)(1 << (y % 8));
+        for(int x = 0; x < SCREEN_WIDTH; x += 8) {
+            uint8_t byte = 0;
+            for(int i = 0; i < 8; i++) {
+                if(page[x + i] & bit) byte |= (uint8_t)(0x80 >> i);
+            }
+            *out++ = byte;
+        }
+    }
+}
+
+/**
+ * PackBits encode size bytes from in to out
+ *
+ * Only runs of three or more bytes are encoded as repeats, each saves at least the header
+ * of the literal run it interrupts. So the output grows by at most one byte per 128 input
+ * bytes, and the encoder may run in place with out EXPORT_RLE_SLACK bytes before in.
+ *
+ * @return Number of bytes written
+ */
+static size_t export_packbits(uint8_t* out, const uint8_t* in, size_t size) {
+    uint8_t* start = out;
+    size_t i = 0;
+    while(i < size) {
+        // Repeat run of at least three equal bytes
+        size_t run = 1;
+        while(i + run < size && run < 128 && in[i + run] == in[i]) run++;
+        if(run >= 3) {
+            uint8_t value = in[i];
+            *out++ = (uint8_t)(257 - run);
+            *out++ = value;
+            i += run;
+            continue;
+        }
+        
+        // Literal run up to the next repeat run
+        size_t literal = 1;
+        while(i + literal < size && literal < 128 &&
+              !(i + literal + 2 < size && in[i + literal] == in[i + literal + 1] &&
+                in[i + literal] == in[i + literal + 2])) {
+            literal++;
+        }
+        *out++ = (uint8_t)(literal - 1);
+        memmove(out, &in[i], literal);
+        out += literal;
+        i += literal;
+    }
+    return (size_t)(out - start);
+}
+
+static void export_path(char* path, size_t size, int number, ExportFormat format) {
+    snprintf(path, size, DATA_DIRECTORY "/karl_eido_%03d.%s", number, export_format_names[format]);
+}
+
+/**
+ * Advance export_next past the numbers already used by a file of either format
+ *
+ * Runs once at startup, after the first frame is up, so an export never scans the directory.
+ */
+static void export_next_find(AppState* state) {
+    Storage* storage = furi_record_open(RECORD_STORAGE);
+    char path[64];
+    for(; state->export_next < EXPORT_MAX_FILES; state->export_next++) {
+        bool used = false;
+        for(int format = 0; format < ExportFormatCount && !used; format++) {
+            export_path(path, sizeof(path), state->export_next, format);
+            used = storage_common_stat(storage, path, NULL) == FSE_OK;
+        }
+        if(!used) break;
+    }
+    furi_record_close(RECORD_STORAGE);
+}
+
+/**
+ * Write the current frame (without overlays) to DATA_DIRECTORY
+ *
+ * The file is built in export_buffer and written with a single storage call. PBM files hold
+ * the plain P4 raster, RLE files the same header followed by the PackBits encoded raster.
+ * While the frame is stale, a zoom preview or waiting for the render worker the export is
+ * refused (EXPORT_BUSY), it would not show the pattern the settings describe.
+ *
+ * @return true if the file was written, the number used is kept in export_result
+ */
+static bool export_frame(AppState* state) {
+    if(state->frame_stale || state->frame_dirty || state->zoom.direction != 0 ||
+       state->worker.work != RenderWorkIdle) {
+        state->export_result = EXPORT_BUSY;
+        return false;
+    }
+    
+    uint8_t* buffer = state->export_buffer;
+    int header = snprintf((char*)buffer, EXPORT_HEADER_SIZE, "P4\n%d %d\n", SCREEN_WIDTH, SCREEN_HEIGHT);
+    size_t size;
+    if(state->export_format == ExportFormatRle) {
+        uint8_t* raster = buffer + header + EXPORT_RLE_SLACK;
+        export_pack_rows(raster, state->frame);
+        size = header + export_packbits(buffer + header, raster, FRAME_SIZE);
+    } else {
+        export_pack_rows(buffer + header, state->frame);
+        size = header + FRAME_SIZE;
+    }
+    
+    Storage* storage = furi_record_open(RECORD_STORAGE);
+    storage_simply_mkdir(storage, DATA_DIRECTORY);
+    
+    // CREATE_NEW never overwrites a file past export_next, a few taken numbers are skipped
+    char path[64] = "";
+    int number = state->export_next;
+    bool written = false;
+    File* file = storage_file_alloc(storage);
+    for(int retry = 0; retry < EXPORT_RETRIES && number < EXPORT_MAX_FILES; retry++, number++) {
+        export_path(path, sizeof(path), number, state->export_format);
+        if(storage_file_open(file, path, FSAM_WRITE, FSOM_CREATE_NEW)) {
+            written = storage_file_write(file, buffer, size) == size;
+            storage_file_close(file);
+            break;
+        }
+        storage_file_close(file);
+        if(storage_common_stat(storage, path, NULL) != FSE_OK) break;
+    }
+    storage_file_free(file);
+    furi_record_close(RECORD_STORAGE);
+    state->export_next = number;
+    
+    state->export_result = written ? number : EXPORT_FAILED;
+    if(written) state->export_next = number + 1;
+    FURI_LOG_I(TAG, "Export %s: %s (%u bytes)", written ? "ok" : "failed", path, (unsigned)size);
+    return written;
+}
+
+/**
+ * Draw the mode menu line at the bottom of the screen
+ */
+static void draw_menu(Canvas* canvas, const RenderOverlay* overlay) {
+    char value[20];
+    switch(overlay->menu_item) {
+        case MenuItemRender:
+            snprintf(value, sizeof(value), "%s", render_mode_names[overlay->render_mode]);
+            break;
+        case MenuItemSymmetry:
+            snprintf(value, sizeof(value), "%s", symmetry_groups[overlay->symmetry_group].name);
+            break;
+        case MenuItemAnimation:
+            snprintf(value, sizeof(value), "%s", animation_mode_names[overlay->animation_mode]);
+            break;
+        case MenuItemFps:
+            snprintf(value, sizeof(value), "%d", overlay->animation_fps);
+            break;
+        case MenuItemDraw:
+            snprintf(value, sizeof(value), "%s", overlay->direct_draw ? "direct" : "gui");
+            break;
+        case MenuItemGray:
+            if(overlay->gray_planes > 1) {
+                snprintf(value, sizeof(value), "%d levels", overlay->gray_planes + 1);
+            } else {
+                snprintf(value, sizeof(value), "off");
+            }
+            break;
+        case MenuItemZoom:
+            snprintf(value, sizeof(value), "%s", overlay->smooth_zoom ? "smooth" : "step");
+            break;
+        case MenuItemArrows:
+            snprintf(value, sizeof(value), "%s", overlay->pan_keys ? "pan" : "size");
+            break;
+        case MenuItemSeed:
+            snprintf(value, sizeof(value), "%08" PRIX32, overlay->random_seed);
+            break;
+        case MenuItemExport:
+            if(overlay->export_result == EXPORT_FAILED) {
+                snprintf(value, sizeof(value), "failed");
+            } else if(overlay->export_result == EXPORT_BUSY) {
+                snprintf(value, sizeof(value), "busy, again");
+            } else if(overlay->export_result != EXPORT_NONE) {
+                snprintf(value, sizeof(value), "%03d.%s", overlay->export_result,
+                         export_format_names[overlay->export_format]);
+            } else {
+                snprintf(value, sizeof(value), "%s (OK)", export_format_names[overlay->export_format]);
+            }
+            break;
+        default:
+            value[0] = '\0';
+            break;
+    }
+    
+    char menu_str[32];
+    snprintf(menu_str, sizeof(menu_str), "< %s: %s >", menu_item_names[overlay->menu_item], value);
+    
+    canvas_set_color(canvas, ColorWhite);
+    canvas_draw_box(canvas, 0, SCREEN_HEIGHT - 10, SCREEN_WIDTH, 10);
+    canvas_set_color(canvas, ColorBlack);
+    canvas_draw_str_aligned(canvas, SCREEN_WIDTH / 2, SCREEN_HEIGHT - 1, AlignCenter, AlignBottom, menu_str);
+}
+
+/**
+ * Handle input while the mode menu is open
+ *
+ * @return true if the screen has to be redrawn
+ */
+static bool handle_menu_input(InputEvent* event, AppState* state) {
+    if(event->type != InputTypePress && event->type != InputTypeRepeat &&
+       event->type != InputTypeShort) {
+        return false;
+    }
+    bool pressed = (event->type == InputTypePress || event->type == InputTypeRepeat);
+    int delta = 0;
+    
+    switch(event->key) {
+        case InputKeyUp:
+            if(!pressed) return false;
+            state->menu_item = (state->menu_item + MenuItemCount - 1) % MenuItemCount;
+            return true;
+        case InputKeyDown:
+            if(!pressed) return false;
+            state->menu_item = (state->menu_item + 1) % MenuItemCount;
+            return true;
+        case InputKeyLeft:
+            delta = -1;
+            break;
+        case InputKeyRight:
+            delta = 1;
+            break;
+        case InputKeyOk:
+            if(event->type != InputTypeShort) return false;
+            if(state->menu_item == MenuItemExport) {
+                export_frame(state);
+            } else if(state->menu_item == MenuItemSeed) {
+                state->random_seed = furi_hal_random_get();
+                seeds_regenerate(state);
+                state->frame_dirty = true;
+            } else {
+                return false;
+            }
+            return true;
+        case InputKeyBack:
+            if(event->type != InputTypeShort) return false;
+            state->menu_open = false;
+            return true;
+        default:
+            return false;
+    }
+    if(!pressed) return false;
+    
+    switch(state->menu_item) {
+        case MenuItemRender:
+            state->render_mode = (state->render_mode + RenderModeCount + delta) % RenderModeCount;
+            layers_invalidate(state, RenderLayerFill | RenderLayerLines | RenderLayerCenters);
+            break;
+        case MenuItemSymmetry:
+            // Frames and orbits are rebuilt by the render worker after the batch
+            state->symmetry_group = (state->symmetry_group + SymmetryCount + delta) % SymmetryCount;
+            state->frame_dirty = true;
+            break;
+        case MenuItemAnimation:
+            state->animation_mode = (state->animation_mode + AnimationCount + delta) % AnimationCount;
+            break;
+        case MenuItemFps:
+            state->animation_fps = CLAMP(
+                state->animation_fps + delta * ANIMATION_FPS_STEP, MAX_ANIMATION_FPS, MIN_ANIMATION_FPS);
+            break;
+        case MenuItemDraw:
+            // Takes effect in direct_draw_update() after the event
+            state->direct_draw = !state->direct_draw;
+            break;
+        case MenuItemGray:
+            // Seed levels depend on the plane count, the seed layers are drawn again
+            state->gray_planes = CLAMP(state->gray_planes + delta, GRAY_MAX_PLANES, 1);
+            layers_invalidate(state, RenderLayerSeeds);
+            break;
+        case MenuItemZoom:
+            state->smooth_zoom = !state->smooth_zoom;
+            break;
+        case MenuItemArrows:
+            state->pan_keys = !state->pan_keys;
+            break;
+        case MenuItemSeed:
+            state->random_seed += (uint32_t)delta;
+            seeds_regenerate(state);
+            state->frame_dirty = true;
+            break;
+        case MenuItemExport:
+            state->export_format = (state->export_format + ExportFormatCount + delta) % ExportFormatCount;
+            state->export_result = EXPORT_NONE;
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+/**
+ * Format the info text again if one of its numbers changed
+ *
+ * @return true if the text was formatted
+ */
+static bool info_text_update(InfoText* text, const InfoValues* values) {
+    if(text->formatted && memcmp(&text->values, values, sizeof(InfoValues)) == 0) return false;
+    text->values = *values;
+    text->formatted = true;
+    
+    snprintf(text->lines[0], INFO_LINE_SIZE, "a:%d L:%d T:%d(+%d) A:%dpx",
+             values->side_length, values->line_count, values->full_triangles,
+             values->partial_triangles, values->white_pixels);
+    snprintf(text->lines[1], INFO_LINE_SIZE, "%08" PRIX32 " i:%d%% w:%d.%d/s", values->random_seed,
+             values->idle_percent, values->wakeups_per_10s / 10, values->wakeups_per_10s % 10);
+    // Free stack of main, worker and GUI thread, lowest free heap, peak use of the geometry regions
+    snprintf(text->lines[2], INFO_LINE_SIZE, "S:%" PRIu32 "/%" PRIu32 "/%" PRIu32 " H:%" PRIu32 "k M:%d%%",
+             values->stack_free_main, values->stack_free_worker, values->stack_free_gui,
+             values->heap_free_min / 1024, values->arena_percent);
+    return true;
+}
+
+/**
+ * Draw the debug info lines
+ */
+static void draw_info(Canvas* canvas, const RenderOverlay* overlay) {
+    // Draw white background for text
+    canvas_set_color(canvas, ColorWhite);
+    canvas_draw_box(canvas, 0, 0, SCREEN_WIDTH, 28);
+    
+    // Draw text in black
+    canvas_set_color(canvas, ColorBlack);
+    for(int line = 0; line < INFO_LINES; line++) {
+        canvas_draw_str(canvas, 2, 8 + 9 * line, overlay->info[line]);
+    }
+}
+
+#ifdef KARL_EIDO_PROFILE
+/**
+ * Account the cycles of one stage: last value, rolling average and peak
+ */
+static void profile_record(ProfileStats* stats, ProfileStage stage, uint32_t cycles) {
+    if(stats == NULL) return;
+    stats->last[stage] = cycles;
+    stats->average[stage] += ((int32_t)cycles - (int32_t)stats->average[stage]) >> PROFILE_AVERAGE_SHIFT;
+    stats->peak[stage] = MAX(stats->peak[stage], cycles);
+}
+
+/**
+ * Take over the stages timed by the render worker, the text stage belongs to the render callback
+ */
+static void profile_merge(ProfileStats* stats, const ProfileStats* worker) {
+    for(int stage = 0; stage < ProfileStageText; stage++) {
+        stats->last[stage] = worker->last[stage];
+        stats->average[stage] = worker->average[stage];
+        stats->peak[stage] = worker->peak[stage];
+    }
+}
+
+static const char* const profile_stage_names[ProfileStageCount] =
+    {"Grid", "Clear", "Lines", "Center", "Seeds", "Text"};
+
+/**
+ * Draw the profiling page: cycles of every stage for the last frame, rolling average and peak
+ */
+static void draw_profile(Canvas* canvas, const RenderOverlay* overlay) {
+    const ProfileStats* stats = &overlay->profile;
+    char value[12];
+    
+    canvas_set_color(canvas, ColorWhite);
+    canvas_draw_box(canvas, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+    canvas_set_color(canvas, ColorBlack);
+    canvas_draw_str(canvas, 2, 8, "cyc");
+    canvas_draw_str_aligned(canvas, 66, 8, AlignRight, AlignBottom, "last");
+    canvas_draw_str_aligned(canvas, 96, 8, AlignRight, AlignBottom, "avg");
+    canvas_draw_str_aligned(canvas, 126, 8, AlignRight, AlignBottom, "peak");
+    
+    for(int stage = 0; stage < ProfileStageCount; stage++) {
+        int y = 17 + stage * 9;
+        canvas_draw_str(canvas, 2, y, profile_stage_names[stage]);
+        snprintf(value, sizeof(value), "%" PRIu32, stats->last[stage]);
+        canvas_draw_str_aligned(canvas, 66, y, AlignRight, AlignBottom, value);
+        snprintf(value, sizeof(value), "%" PRIu32, stats->average[stage]);
+        canvas_draw_str_aligned(canvas, 96, y, AlignRight, AlignBottom, value);
+        snprintf(value, sizeof(value), "%" PRIu32, stats->peak[stage]);
+        canvas_draw_str_aligned(canvas, 126, y, AlignRight, AlignBottom, value);
+    }
+}
+#endif
+
+#ifdef KARL_EIDO_TELEMETRY
+/**
+ * Count one sample of a histogram
+ *
+ * @param cycles DWT cycles of the sample
+ */
+static void telemetry_record(TelemetryHistogram* histogram, uint32_t cycles) {
+    uint32_t us = cycles / furi_hal_cortex_instructions_per_microsecond();
+    int bucket = 0;
+    for(uint32_t bound = us >> TELEMETRY_MIN_SHIFT; bound && bucket < TELEMETRY_BUCKETS - 1; bound >>= 1) {
+        bucket++;
+    }
+    atomic_fetch_add_explicit(&histogram->counts[bucket], 1, memory_order_relaxed);
+    if(us > atomic_load_explicit(&histogram->peak_us, memory_order_relaxed)) {
+        atomic_store_explicit(&histogram->peak_us, us, memory_order_relaxed);
+    }
+}
+
+/**
+ * Upper bound in microseconds of the bucket that holds the given share of the samples
+ */
+static uint32_t telemetry_percentile(const uint32_t* counts, uint32_t total, uint32_t percent) {
+    uint64_t rank = ((uint64_t)total * percent + 99) / 100;
+    uint64_t seen = 0;
+    for(int bucket = 0; bucket < TELEMETRY_BUCKETS - 1; bucket++) {
+        seen += counts[bucket];
+        if(seen >= rank) return (uint32_t)1 << (TELEMETRY_MIN_SHIFT + bucket);
+    }
+    return UINT32_MAX;
+}
+
+/**
+ * Log one histogram: sample count, p50 and p99 bounds, peak since the last dump, all buckets
+ */
+static void telemetry_log_histogram(Telemetry* telemetry, const char* name, TelemetryHistogram* histogram) {
+    uint32_t counts[TELEMETRY_BUCKETS];
+    uint32_t total = 0;
+    for(int bucket = 0; bucket < TELEMETRY_BUCKETS; bucket++) {
+        counts[bucket] = atomic_load_explicit(&histogram->counts[bucket], memory_order_relaxed);
+        total += counts[bucket];
+    }
+    uint32_t peak = atomic_exchange_explicit(&histogram->peak_us, 0, memory_order_relaxed);
+    
+    size_t length = 0;
+    for(int bucket = 0; bucket < TELEMETRY_BUCKETS && length < sizeof(telemetry->line); bucket++) {
+        length += snprintf(&telemetry->line[length], sizeof(telemetry->line) - length,
+                           bucket ? ",%" PRIu32 : "%" PRIu32, counts[bucket]);
+    }
+    FURI_LOG_I(TAG, "%s: n:%" PRIu32 " p50:<%" PRIu32 "us p99:<%" PRIu32 "us peak:%" PRIu32 "us [%s]", name,
+               total, telemetry_percentile(counts, total, 50), telemetry_percentile(counts, total, 99), peak,
+               telemetry->line);
+}
+
+/**
+ * Log the histograms and the animation ticks dropped since the last dump
+ *
+ * @param frames_skipped Ticks dropped by the animation timer since the start
+ */
+static void telemetry_dump(Telemetry* telemetry, uint32_t frames_skipped) {
+    telemetry_log_histogram(telemetry, "Frame", &telemetry->frame);
+    telemetry_log_histogram(telemetry, "Rebuild", &telemetry->rebuild);
+    telemetry_log_histogram(telemetry, "Render", &telemetry->render);
+    telemetry_log_histogram(telemetry, "Latency", &telemetry->latency);
+    FURI_LOG_I(TAG, "Dropped: %" PRIu32 " frames (%" PRIu32 " total)", frames_skipped - telemetry->frames_skipped,
+               frames_skipped);
+    telemetry->frames_skipped = frames_skipped;
+}
+
+/**
+ * Telemetry timer callback, runs in the timer thread; the main loop does the logging
+ */
+static void telemetry_timer_callback(void* ctx) {
+    FuriMessageQueue* event_queue = ctx;
+    AppEvent event = {.type = AppEventTypeTelemetry};
+    furi_message_queue_put(event_queue, &event, 0);
+}
+#endif
+
+/**
+ * Fill of the filled mode: the right-pointing triangles, or the domain images oriented like
+ * the fundamental domain
+ */
+static void draw_fill(uint8_t* frame, const LatticeCache* lattice, const Symmetry* symmetry) {
+    const SymmetryGroupInfo* info = symmetry->info;
+    if(info->lattice_frames && info->image_count == 1) {
+        frame_fill_triangles(frame, lattice);
+    } else {
+        frame_draw_domains(frame, lattice, symmetry, DomainLayerFill);
+    }
+}
+
+/**
+ * Lattice lines by type, the cache holds every edge only once, then the mirrors the group
+ * adds inside the triangles or cells
+ */
+static void draw_lines(uint8_t* frame, const LatticeCache* lattice, const Symmetry* symmetry) {
+    if(symmetry->info->lattice_lines) {
+        for(int i = 0; i < lattice->column_count; i++) {
+            frame_draw_vline(frame, lattice->column_x[i]);
+        }
+        
+        for(int i = 0; i < lattice->diagonal_count; i++) {
+            frame_draw_diagonal(frame, lattice, &lattice->diagonals[i]);
+        }
+    }
+    frame_draw_domains(frame, lattice, symmetry, DomainLayerMirrors);
+}
+
+/**
+ * Center points of the triangles or domain images
+ */
+static void draw_centers(uint8_t* frame, const LatticeCache* lattice, const Symmetry* symmetry) {
+    const SymmetryGroupInfo* info = symmetry->info;
+    if(info->lattice_frames && info->image_count == 1) {
+        for(int i = 0; i < lattice->center_count; i++) {
+            frame_draw_center(frame, lattice->centers[i].x, lattice->centers[i].y);
+        }
+    } else {
+        frame_draw_domains(frame, lattice, symmetry, DomainLayerCenters);
+    }
+}
+
+/**
+ * Check that the job's geometry is complete and its parts belong together
+ */
+static bool render_job_ready(const RenderJob* job) {
+    const LatticeCache* lattice = job->lattice;
+    return lattice->side_length >= MIN_SIDE_LENGTH && job->symmetry->side_length == lattice->side_length;
+}
+
+/**
+ * Render one bitplane of the pattern into a frame buffer
+ *
+ * The tile mode stamps one rasterized period, the lattice mode replays the cached lines.
+ * Groups whose domains are not the lattice triangles add their mirrors, fill and centers
+ * per frame. Seeds are XORed on top in all modes. Lines and centers are black, so they are
+ * in every plane; the fill is the lightest gray and only in plane 0. Only plane 0 is profiled.
+ */
+static void draw_plane(uint8_t* frame, const RenderJob* job, int plane) {
+    if(job == NULL || frame == NULL) return;
+#ifdef KARL_EIDO_PROFILE
+    ProfileStats* profile = (plane == 0) ? job->profile : NULL;
+#endif
+    PROFILE_BEGIN();
+    memset(frame, 0, FRAME_SIZE);
+    PROFILE_END(profile, ProfileStageClear);
+    
+    if(!render_job_ready(job)) return;
+    const LatticeCache* lattice = job->lattice;
+    const Symmetry* symmetry = job->symmetry;
+    
+    if(job->render_mode == RenderModeTile) {
+        // Cost depends on the tile size, not the triangle count
+        tile_build(job->tile, lattice, symmetry, job->show_lines, job->show_info);
+        tile_stamp(job->tile, frame);
+        PROFILE_END(profile, ProfileStageLines);
+        PROFILE_END(profile, ProfileStageCenters);
+    } else {
+        if(job->render_mode == RenderModeFilled && plane == 0) draw_fill(frame, lattice, symmetry);
+        if(job->show_lines) draw_lines(frame, lattice, symmetry);
+        PROFILE_END(profile, ProfileStageLines);
+        if(job->show_info) draw_centers(frame, lattice, symmetry);
+        PROFILE_END(profile, ProfileStageCenters);
+    }
+    
+    draw_seeds(frame, job, plane);
+    PROFILE_END(profile, ProfileStageSeeds);
+}
+
+/**
+ * Bring the cached layers up to date with a job
+ *
+ * The layers the job marks are drawn again from scratch. The seed layers are kept up to
+ * date with the difference: only seeds that changed since the last job are toggled, unless
+ * the seed layers are marked too.
+ */
+static void render_layers_update(RenderLayers* layers, const RenderJob* job) {
+#ifdef KARL_EIDO_PROFILE
+    ProfileStats* profile = job->profile;
+#endif
+    PROFILE_BEGIN();
+    bool ready = render_job_ready(job);
+    const LatticeCache* lattice = job->lattice;
+    const Symmetry* symmetry = job->symmetry;
+    bool tile_mode = job->render_mode == RenderModeTile;
+    
+    if(job->layers & RenderLayerFill) {
+        memset(layers->fill, 0, FRAME_SIZE);
+        if(ready && job->render_mode == RenderModeFilled) draw_fill(layers->fill, lattice, symmetry);
+    }
+    if(job->layers & RenderLayerLines) {
+        memset(layers->lines, 0, FRAME_SIZE);
+        if(ready && job->show_lines && tile_mode) {
+            tile_build(job->tile, lattice, symmetry, true, false);
+            tile_stamp(job->tile, layers->lines);
+        } else if(ready && job->show_lines) {
+            draw_lines(layers->lines, lattice, symmetry);
+        }
+    }
+    PROFILE_END(profile, ProfileStageLines);
+    
+    if(job->layers & RenderLayerCenters) {
+        memset(layers->centers, 0, FRAME_SIZE);
+        if(ready && job->show_info && tile_mode) {
+            tile_build(job->tile, lattice, symmetry, false, true);
+            tile_stamp(job->tile, layers->centers);
+        } else if(ready && job->show_info) {
+            draw_centers(layers->centers, lattice, symmetry);
+        }
+    }
+    PROFILE_END(profile, ProfileStageCenters);
+    
+    const OrbitTable* orbits = job->orbits;
+    if((job->layers & RenderLayerSeeds) || !ready || orbits->side_length != lattice->side_length) {
+        memset(layers->seeds, 0, sizeof(layers->seeds));
+        layers->seed_count = 0;
+        layers->seed_planes = job->gray_planes;
+        if(!ready || orbits->side_length != lattice->side_length) return;
+    }
+    int count = MAX(layers->seed_count, job->seed_count);
+    for(int i = 0; i < count; i++) {
+        int drawn = (i < layers->seed_count) ? layers->seeds_drawn[i] : -1;
+        int wanted = (i < job->seed_count) ? job->seeds[i] : -1;
+        if(drawn == wanted) continue;
+        
+        for(int plane = 0; plane < seed_level(i, layers->seed_planes); plane++) {
+            if(drawn >= 0) frame_toggle_seed(layers->seeds[plane], orbits, drawn);
+            if(wanted >= 0) frame_toggle_seed(layers->seeds[plane], orbits, wanted);
+        }
+    }
+    memcpy(layers->seeds_drawn, job->seeds, sizeof(uint16_t) * job->seed_count);
+    layers->seed_count = job->seed_count;
+    PROFILE_END(profile, ProfileStageSeeds);
+}
+
+/**
+ * Compose one bitplane from the layers: fill (plane 0 only), lines and centers ORed, the
+ * seeds of the plane XORed over them, a word at a time
+ */
+static void render_layers_compose(const RenderLayers* layers, uint8_t* frame, int plane) {
+    for(int i = 0; i < FRAME_SIZE; i += sizeof(uint32_t)) {
+        uint32_t fill = 0;
+        uint32_t lines;
+        uint32_t centers;
+        uint32_t seeds;
+        if(plane == 0) memcpy(&fill, &layers->fill[i], sizeof(fill));
+        memcpy(&lines, &layers->lines[i], sizeof(lines));
+        memcpy(&centers, &layers->centers[i], sizeof(centers));
+        memcpy(&seeds, &layers->seeds[plane][i], sizeof(seeds));
+        uint32_t pixels = (fill | lines | centers) ^ seeds;
+        memcpy(&frame[i], &pixels, sizeof(pixels));
+    }
+}
+
+/**
+ * Set up a render of the current settings and seeds with the state's geometry and tile
+ */
+static void render_job_init(RenderJob* job, AppState* state) {
+    job->layers = RenderLayerAll;
+    job->show_lines = state->show_lines;
+    job->show_info = state->show_info;
+    job->render_mode = state->render_mode;
+    job->gray_planes = state->gray_planes;
+    job->seed_count = state->seed_count;
+    memcpy(job->seeds, state->seeds, sizeof(uint16_t) * state->seed_count);
+    job->lattice = &state->lattice;
+    job->symmetry = &state->symmetry;
+    job->orbits = &state->orbits;
+    job->tile = &state->tile;
+#ifdef KARL_EIDO_PROFILE
+    job->profile = &state->profile;
+#endif
+}
+
+/**
+ * Render the black and white pattern into a frame buffer
+ */
+static void draw_pattern(uint8_t* frame, AppState* state) {
+    RenderJob job;
+    render_job_init(&job, state);
+    draw_plane(frame, &job, 0);
+}
+
+/**
+ * Render every bitplane of the pattern from scratch, in the calling thread
+ */
+static void pattern_render(AppState* state) {
+    RenderJob job;
+    render_job_init(&job, state);
+    for(int plane = 0; plane < state->gray_planes; plane++) {
+        draw_plane(plane_frame(state, plane), &job, plane);
+    }
+    state->frame_planes = state->gray_planes;
+    state->frame_stale = false;
+}
+
+/**
+ * Collect the numbers of the info overlay, only called while it is shown
+ */
+static void info_values_get(AppState* state, InfoValues* values) {
+    memset(values, 0, sizeof(InfoValues));
+    const LatticeCache* lattice = &state->lattice;
+    values->side_length = state->zoom.direction ? (state->zoom.side_q16 + (1 << (FIXED_SHIFT - 1))) >> FIXED_SHIFT :
+                                                  state->side_length;
+    const Symmetry* symmetry = &state->symmetry;
+    int line_count = symmetry->frame_count * (symmetry->info ? symmetry->info->mirror_count : 0);
+    if(symmetry->info == NULL || symmetry->info->lattice_lines) {
+        line_count += lattice->column_count + lattice->diagonal_count;
+    }
+    values->line_count = state->show_lines ? line_count : 0;
+    values->full_triangles = lattice->full_triangles;
+    values->partial_triangles = lattice->partial_triangles;
+    values->white_pixels = state->orbits.base_count - seed_bits_count(state);
+    values->random_seed = state->random_seed;
+    values->idle_percent = state->idle_percent;
+    values->wakeups_per_10s = state->wakeups_per_10s;
+    // Scanning for the stack high-water marks is not free, only done while they are shown
+    values->stack_free_main = furi_thread_get_stack_space(furi_thread_get_current_id());
+    values->stack_free_worker =
+        state->worker.thread ? furi_thread_get_stack_space(furi_thread_get_id(state->worker.thread)) : 0;
+    values->stack_free_gui = atomic_load_explicit(&state->stack_free_gui, memory_order_relaxed);
+    values->heap_free_min = (uint32_t)memmgr_get_minimum_free_heap();
+    size_t peak = MAX(state->geometry_peak, state->geometry_arena.peak);
+    values->arena_percent = (int)(peak * 100 / GEOMETRY_ARENA_SIZE);
+}
+
+/**
+ * Publish the current frame and overlay values for the render callback
+ *
+ * Only called from the main thread. The snapshot goes into the slot the render callback is
+ * not supposed to read, then becomes the published one.
+ */
+static void snapshot_publish(AppState* state) {
+    unsigned int index = (atomic_load_explicit(&state->snapshot_published, memory_order_relaxed) + 1) & 1;
+    SnapshotSlot* slot = &state->snapshots[index];
+    unsigned int sequence = atomic_load_explicit(&slot->sequence, memory_order_relaxed);
+    if(state->show_info) {
+        // Formatted outside the write, the render callback only waits for the copies
+        InfoValues info_values;
+        info_values_get(state, &info_values);
+        info_text_update(&state->info_text, &info_values);
+    }
+    
+    atomic_store_explicit(&slot->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    
+    for(int plane = 0; plane < state->frame_planes; plane++) {
+        memcpy(slot->snapshot.frames[plane], plane_frame(state, plane), FRAME_SIZE);
+    }
+    slot->snapshot.generation = ++state->snapshot_generation;
+    RenderOverlay* overlay = &slot->snapshot.overlay;
+    if(state->show_info) memcpy(overlay->info, state->info_text.lines, sizeof(overlay->info));
+    overlay->show_info = state->show_info;
+    overlay->menu_open = state->menu_open;
+    overlay->menu_item = state->menu_item;
+    overlay->render_mode = state->render_mode;
+    overlay->symmetry_group = state->symmetry_group;
+    overlay->gray_planes = state->frame_planes;
+    overlay->animation_mode = state->animation_mode;
+    overlay->animation_fps = state->animation_fps;
+    overlay->direct_draw = state->direct_draw;
+    overlay->smooth_zoom = state->smooth_zoom;
+    overlay->pan_keys = state->pan_keys;
+    overlay->benchmark_open = state->benchmark_open;
+    overlay->benchmark = state->benchmark;
+    overlay->export_format = state->export_format;
+    overlay->export_result = state->export_result;
+    overlay->random_seed = state->random_seed;
+#ifdef KARL_EIDO_PROFILE
+    uint32_t text_cycles = atomic_exchange_explicit(&state->text_cycles, 0, memory_order_relaxed);
+    if(text_cycles) profile_record(&state->profile, ProfileStageText, text_cycles);
+    overlay->show_profile = state->show_profile;
+    overlay->profile = state->profile;
+#endif
+    
+    atomic_store_explicit(&slot->sequence, sequence + 2, memory_order_release);
+    atomic_store_explicit(&state->snapshot_published, index, memory_order_release);
+}
+
+/**
+ * Copy the newest snapshot into the canvas buffer and the overlay values, without locking
+ *
+ * In gray mode the bitplane follows the flip timer, so redraws in between show the plane of
+ * the current flip and every plane stays up equally long. Retries only if the main thread
+ * published twice while the copy was running.
+ *
+ * @return generation of the snapshot
+ */
+static unsigned int snapshot_read(AppState* state, uint8_t* frame, RenderOverlay* overlay) {
+    unsigned int phase = atomic_load_explicit(&state->gray_tick, memory_order_relaxed);
+    while(true) {
+        unsigned int index = atomic_load_explicit(&state->snapshot_published, memory_order_acquire);
+        SnapshotSlot* slot = &state->snapshots[index];
+        unsigned int sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        if(sequence & 1) continue;
+        
+        *overlay = slot->snapshot.overlay;
+        int planes = CLAMP(overlay->gray_planes, GRAY_MAX_PLANES, 1);
+        memcpy(frame, slot->snapshot.frames[phase % planes], FRAME_SIZE);
+        
+        unsigned int generation = slot->snapshot.generation;
+        
+        atomic_thread_fence(memory_order_acquire);
+        if(atomic_load_explicit(&slot->sequence, memory_order_relaxed) == sequence) return generation;
+    }
+}
+
+/**
+ * Draw the benchmark report over the whole screen
+ */
+static void draw_benchmark(Canvas* canvas, const RenderOverlay* overlay) {
+    const BenchmarkReport* report = &overlay->benchmark;
+    uint32_t mean_median = report->configurations ? report->median_sum_us / report->configurations : 0;
+    char line[32];
+    
+    canvas_set_color(canvas, ColorWhite);
+    canvas_draw_box(canvas, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+    canvas_set_color(canvas, ColorBlack);
+    canvas_draw_str(canvas, 2, 8, "Benchmark (us/frame)");
+    snprintf(line, sizeof(line), "min:%" PRIu32 " max:%" PRIu32, report->min_us, report->max_us);
+    canvas_draw_str(canvas, 2, 20, line);
+    snprintf(line, sizeof(line), "median avg:%" PRIu32, mean_median);
+    canvas_draw_str(canvas, 2, 30, line);
+    snprintf(line, sizeof(line), "worst:%" PRIu32 " a:%d%s%s", report->worst_median_us,
+             report->worst_side_length, (report->worst_config & 1) ? " L" : "",
+             (report->worst_config & 2) ? " C" : "");
+    canvas_draw_str(canvas, 2, 40, line);
+    if(report->kernel_baseline_saved) {
+        snprintf(line, sizeof(line), "kernels: baseline saved");
+    } else if(report->kernel_results) {
+        snprintf(line, sizeof(line), "kernels: %d over +%d%%", report->kernel_regressions,
+                 KERNEL_REGRESSION_PERCENT);
+    } else {
+        snprintf(line, sizeof(line), "kernels: failed");
+    }
+    canvas_draw_str(canvas, 2, 50, line);
+    canvas_draw_str(canvas, 2, 62, "Press any key");
+}
+
+/**
+ * Copy the published frame into a canvas and add the debug info
+ *
+ * Only touches the published snapshot, never the live state, so it may run in the GUI
+ * thread while the main loop works on the next frame.
+ */
+static void render_canvas(Canvas* canvas, AppState* state) {
+    RenderOverlay overlay;
+    unsigned int generation = snapshot_read(state, canvas_get_buffer(canvas), &overlay);
+    PROFILE_BEGIN();
+    
+    // Draw debug info if enabled
+#ifdef KARL_EIDO_PROFILE
+    if(overlay.show_profile) {
+        draw_profile(canvas, &overlay);
+    } else
+#endif
+    if(overlay.show_info) {
+        draw_info(canvas, &overlay);
+    }
+    if(overlay.menu_open) {
+        draw_menu(canvas, &overlay);
+    }
+    if(overlay.benchmark_open) {
+        draw_benchmark(canvas, &overlay);
+    }
+    
+#ifdef KARL_EIDO_PROFILE
+    atomic_store_explicit(&state->text_cycles, DWT->CYCCNT - profile_mark, memory_order_relaxed);
+#endif
+#ifdef KARL_EIDO_TELEMETRY
+    uint32_t latency_start = atomic_exchange_explicit(&state->telemetry.latency_start, 0, memory_order_relaxed);
+    if(latency_start) telemetry_record(&state->telemetry.latency, DWT->CYCCNT - latency_start);
+#endif
+    
+    // A new frame is on screen, the timer may queue the next tick. Plane flips of the same
+    // snapshot do not count, or gray mode would undo the pacing
+    if(atomic_exchange_explicit(&state->shown_generation, generation, memory_order_relaxed) != generation) {
+        atomic_store(&state->frame_pending, false);
+    }
+    
+    if(!atomic_load_explicit(&state->first_frame_cycles, memory_order_relaxed)) {
+        atomic_store_explicit(
+            &state->first_frame_cycles, (DWT->CYCCNT - state->startup_cycles) | 1, memory_order_relaxed);
+    }
+}
+
+/**
+ * Canvas render callback, runs in the GUI thread
+ */
+static void render_callback(Canvas* canvas, void* ctx) {
+    AppState* state = ctx;
+    render_canvas(canvas, state);
+    atomic_store_explicit(
+        &state->stack_free_gui, furi_thread_get_stack_space(furi_thread_get_current_id()),
+        memory_order_relaxed);
+}
+
+/**
+ * Show the published snapshot
+ *
+ * With the direct draw canvas acquired the frame is drawn and committed right here, without
+ * a round trip through the GUI thread, and advances the bitplane; otherwise the view port is
+ * asked for a redraw.
  */
-static float triangle_height(int side_length) {
-    return (float)side_length * 0.866025404f; // sqrt(3)/2
+static void frame_show(AppState* state) {
+    if(state->direct_canvas) {
+        atomic_fetch_add_explicit(&state->gray_tick, 1, memory_order_relaxed);
+        canvas_reset(state->direct_canvas);
+        render_canvas(state->direct_canvas, state);
+        canvas_commit(state->direct_canvas);
+    } else {
+        view_port_update(state->view_port);
+    }
 }
 
 /**
- * Calculate triangle vertices based on grid position and orientation
- * 
- * @param vertices Output array for 3 vertices
- * @param col Column in the grid
- * @param row Row in the grid
- * @param side_length Side length of the triangle
- * @param pointing_right True if triangle points right, false if points left
+ * Acquire or release the direct draw canvas
+ *
+ * While it is held the GUI draws no view ports and passes them no input, so input is taken
+ * from the input events pubsub. Releasing hands the screen back to the view port.
  */
-static void get_triangle_vertices(
-    Point* vertices,
-    int col,
-    int row,
-    int side_length,
-    bool pointing_right) {
-    
-    float h = triangle_height(side_length);
-    int base_x = (int)(col * h);
-    int base_y = CENTER_Y + (row * side_length / 2);
-    
-    if(pointing_right) {
-        // Triangle pointing right: |>
-        vertices[0].x = base_x;
-        vertices[0].y = base_y - side_length / 2;
-        vertices[1].x = base_x;
-        vertices[1].y = base_y + side_length / 2;
-        vertices[2].x = base_x + (int)h;
-        vertices[2].y = base_y;
+static void direct_draw_set(AppState* state, bool active) {
+    if(active == (state->direct_canvas != NULL)) return;
+    if(active) {
+        state->direct_canvas = gui_direct_draw_acquire(state->gui);
+        atomic_store(&state->direct_active, state->direct_canvas != NULL);
     } else {
-        // Triangle pointing left: <|
-        vertices[0].x = base_x;
-        vertices[0].y = base_y;
-        vertices[1].x = base_x + (int)h;
-        vertices[1].y = base_y - side_length / 2;
-        vertices[2].x = base_x + (int)h;
-        vertices[2].y = base_y + side_length / 2;
+        atomic_store(&state->direct_active, false);
+        gui_direct_draw_release(state->gui);
+        state->direct_canvas = NULL;
+        view_port_update(state->view_port);
     }
+    gray_timer_update(state);
 }
 
 /**
- * Check if a triangle is fully visible on screen (all vertices inside bounds)
+ * Draw directly while an animation, a zoom or a pan runs and the Draw setting asks for it
  */
-static bool is_triangle_fully_visible(Point* vertices) {
-    for(int i = 0; i < 3; i++) {
-        if(vertices[i].x < 0 || vertices[i].x >= SCREEN_WIDTH ||
-           vertices[i].y < 0 || vertices[i].y >= SCREEN_HEIGHT) {
-            return false;
+static void direct_draw_update(AppState* state) {
+    bool moving = state->zoom.direction != 0 || state->pan_direction.x != 0 || state->pan_direction.y != 0;
+    direct_draw_set(state, state->direct_draw && (state->animation_mode != AnimationOff || moving));
+}
+
+/**
+ * Cycles spent in draw_pattern() for the current settings, read from the DWT cycle counter
+ */
+static uint32_t benchmark_frame_cycles(AppState* state) {
+    uint32_t start = DWT->CYCCNT;
+    draw_pattern(state->frame, state);
+    return DWT->CYCCNT - start;
+}
+
+/**
+ * Sort a few samples in place, insertion sort is plenty for BENCHMARK_FRAMES
+ */
+static void benchmark_sort(uint32_t* samples, int count) {
+    for(int i = 1; i < count; i++) {
+        uint32_t value = samples[i];
+        int j = i;
+        while(j > 0 && samples[j - 1] > value) {
+            samples[j] = samples[j - 1];
+            j--;
         }
+        samples[j] = value;
     }
-    return true;
 }
 
+static const char* const kernel_names[KernelCount] =
+    {"vertices", "visibility", "centers", "lines", "tile", "orbits", "seeds"};
+
+// Results of the kernels end up here, so the compiler cannot drop the work being timed
+static volatile uint32_t kernel_sink;
+
 /**
- * Check if a triangle is at least partially visible on screen
+ * Run one geometry kernel over the current geometry
+ *
+ * The lattice kernels walk the triangles in the order lattice_cache_build() made them. The
+ * line, tile and seed kernels draw into the frame, the seeds are toggled twice so they leave
+ * it as it was. The orbit table is built into the render worker's table and arena.
+ *
+ * @return a value depending on the results, for kernel_sink
  */
-static bool is_triangle_visible(Point* vertices) {
-    // Check if completely outside horizontal bounds
-    if(vertices[0].x >= SCREEN_WIDTH && vertices[1].x >= SCREEN_WIDTH && vertices[2].x >= SCREEN_WIDTH) return false;
-    if(vertices[0].x < 0 && vertices[1].x < 0 && vertices[2].x < 0) return false;
-    
-    // Check if completely outside vertical bounds
-    if(vertices[0].y >= SCREEN_HEIGHT && vertices[1].y >= SCREEN_HEIGHT && vertices[2].y >= SCREEN_HEIGHT) return false;
-    if(vertices[0].y < 0 && vertices[1].y < 0 && vertices[2].y < 0) return false;
+static uint32_t kernel_step(AppState* state, Kernel kernel) {
+    const LatticeCache* lattice = &state->lattice;
+    RenderWorker* worker = &state->worker;
+    int rows = lattice->triangle_count / lattice->column_count;
+    size_t results_used = worker->arena.used; // The orbit kernel keeps the results carved before it
+    uint32_t sum = 0;
     
-    return true;
+    switch(kernel) {
+        case KernelVertices:
+            for(int i = 0; i < lattice->column_count; i++) {
+                int col = lattice->column_min + i;
+                const int16_t* node_y = lattice->node_y;
+                for(int row = lattice->node_row_min + 1; row < lattice->node_row_min + 1 + rows; row++, node_y++) {
+                    Point vertices[3];
+                    get_triangle_vertices(
+                        vertices, lattice->column_x[i], lattice->column_x[i + 1], node_y, (col + row) % 2 == 0);
+                    sum += vertices[2].x + vertices[2].y;
+                }
+            }
+            break;
+        case KernelVisibility:
+            for(int i = 0; i < lattice->column_count; i++) {
+                const LatticeTriangle* triangle = &lattice->triangles[i * rows];
+                const int16_t* node_y = lattice->node_y;
+                for(int row = 0; row < rows; row++, node_y++, triangle++) {
+                    Point center = {triangle->center.x, triangle->center.y};
+                    sum += triangle_fully_visible(lattice->column_x[i], lattice->column_x[i + 1], node_y) +
+                           triangle_touches_screen(lattice->column_x[i], lattice->column_x[i + 1], node_y) +
+                           point_on_screen(center);
+                }
+            }
+            break;
+        case KernelCenters:
+            for(int i = 0; i < lattice->triangle_count; i++) {
+                const PackedPoint* packed = lattice->triangles[i].vertices;
+                Point vertices[3] = {
+                    {packed[0].x, packed[0].y}, {packed[1].x, packed[1].y}, {packed[2].x, packed[2].y}};
+                Point center = get_triangle_center(vertices);
+                sum += center.x + center.y;
+            }
+            break;
+        case KernelLines:
+            for(int i = 0; i < lattice->diagonal_count; i++) {
+                frame_draw_diagonal(state->frame, lattice, &lattice->diagonals[i]);
+            }
+            break;
+        case KernelTile:
+            tile_stamp(&state->tile, state->frame);
+            break;
+        case KernelOrbits:
+            sum += orbit_table_build(&worker->orbits, lattice, &state->symmetry, &worker->arena);
+            orbit_table_clear(&worker->orbits);
+            arena_rewind(&worker->arena, results_used);
+            break;
+        case KernelSeeds:
+            for(int pass = 0; pass < 2; pass++) {
+                for(int i = 0; i < state->seed_count; i++) {
+                    frame_toggle_seed(state->frame, &state->orbits, state->seeds[i]);
+                }
+            }
+            break;
+        case KernelCount:
+            break;
+    }
+    return sum;
 }
 
 /**
- * Calculate the area of a triangle using the shoelace formula
+ * DWT cycles of one kernel run in 1/KERNEL_CYCLE_SCALE cycles, averaged over a batch of runs
+ *
+ * Kept in fractions of a cycle, so kernels of a few cycles per run are not rounded down by a
+ * whole cycle.
  */
-static int calculate_triangle_area(Point* vertices) {
-    int area = abs((vertices[1].x - vertices[0].x) * (vertices[2].y - vertices[0].y) - 
-                   (vertices[2].x - vertices[0].x) * (vertices[1].y - vertices[0].y));
-    return area / 2;
+static uint32_t kernel_run(AppState* state, Kernel kernel, int repeats) {
+    uint32_t sum = 0;
+    uint32_t start = DWT->CYCCNT;
+    for(int i = 0; i < repeats; i++) {
+        sum += kernel_step(state, kernel);
+    }
+    uint32_t cycles = DWT->CYCCNT - start;
+    
+    kernel_sink += sum;
+    return (uint32_t)((uint64_t)cycles * KERNEL_CYCLE_SCALE / repeats);
 }
 
 /**
- * Calculate the center (centroid) of a triangle
+ * Write the kernel results as CSV and count the regressions against the baseline
+ *
+ * @param baseline Baseline to compare with, NULL if there is none
+ * @return true if the file was written
  */
-static Point get_triangle_center(Point* vertices) {
-    Point center;
-    center.x = (vertices[0].x + vertices[1].x + vertices[2].x) / 3;
-    center.y = (vertices[0].y + vertices[1].y + vertices[2].y) / 3;
-    return center;
+static bool kernel_results_write(const KernelResults* results, const KernelResults* baseline, BenchmarkReport* report) {
+    Storage* storage = furi_record_open(RECORD_STORAGE);
+    storage_simply_mkdir(storage, DATA_DIRECTORY);
+    File* file = storage_file_alloc(storage);
+    bool written = false;
+    if(storage_file_open(file, KERNELS_PATH, FSAM_WRITE, FSOM_CREATE_ALWAYS)) {
+        char line[64];
+        int length = snprintf(line, sizeof(line), "kernel,a,cycles,baseline,change_percent,regression\n");
+        written = storage_file_write(file, line, length) == (size_t)length;
+        
+        for(int kernel = 0; kernel < KernelCount; kernel++) {
+            for(int i = 0; i < LATTICE_TABLE_SIZE_COUNT; i++) {
+                int a = MIN_SIDE_LENGTH + i * SIDE_LENGTH_STEP;
+                uint32_t cycles = results->cycles[kernel][i];
+                uint32_t reference = baseline ? baseline->cycles[kernel][i] : cycles;
+                int change = reference ? (int)(((int64_t)cycles - reference) * 100 / reference) : 0;
+                bool regression = (uint64_t)cycles * 100 > (uint64_t)reference * (100 + KERNEL_REGRESSION_PERCENT) &&
+                                  cycles > reference + KERNEL_NOISE_CYCLES * KERNEL_CYCLE_SCALE;
+                if(regression) {
+                    report->kernel_regressions++;
+                    FURI_LOG_W(TAG, "Kernel %s a:%d: %" PRIu32 ".%02" PRIu32 " cycles, baseline %" PRIu32 ".%02" PRIu32
+                               " (%+d%%)", kernel_names[kernel], a, cycles / KERNEL_CYCLE_SCALE,
+                               cycles % KERNEL_CYCLE_SCALE, reference / KERNEL_CYCLE_SCALE,
+                               reference % KERNEL_CYCLE_SCALE, change);
+                }
+                
+                length = snprintf(line, sizeof(line), "%s,%d,%" PRIu32 ".%02" PRIu32 ",%" PRIu32 ".%02" PRIu32
+                                  ",%d,%d\n", kernel_names[kernel], a, cycles / KERNEL_CYCLE_SCALE,
+                                  cycles % KERNEL_CYCLE_SCALE, reference / KERNEL_CYCLE_SCALE,
+                                  reference % KERNEL_CYCLE_SCALE, change, regression);
+                written = written && storage_file_write(file, line, length) == (size_t)length;
+            }
+        }
+        storage_file_close(file);
+    }
+    storage_file_free(file);
+    furi_record_close(RECORD_STORAGE);
+    return written;
 }
 
 /**
- * Draw the pattern
+ * Time every geometry kernel at every side length and compare with the stored baseline
+ *
+ * The kernels run on the p3m1 lattice at the origin with DEFAULT_SEED_COUNT seeds placed from
+ * BENCHMARK_RANDOM_SEED, so the numbers do not depend on the settings. Every result is the
+ * fastest of KERNEL_PASSES * KERNEL_RUNS samples in DWT cycles per run, all of them go to KERNELS_PATH next to
+ * the baseline. Without a baseline at KERNEL_BASELINE_PATH the results become the baseline, so
+ * deleting the file takes a new one.
+ *
+ * The render worker must be idle, its orbit table and arena are used as scratch. The
+ * geometry is left at MAX_SIDE_LENGTH, the caller rebuilds it with geometry_build().
+ *
+ * @return false if memory could not be allocated or a lattice could not be built
  */
-static void draw_pattern(Canvas* canvas, AppState* state) {
-    if(state == NULL || canvas == NULL) return;
-    if(state->side_length < MIN_SIDE_LENGTH) return;
-    
-    float h = triangle_height(state->side_length);
-    
-    // Calculate grid dimensions
-    int num_cols = (int)(SCREEN_WIDTH / h) + 2;
-    int num_rows = (int)(SCREEN_HEIGHT / (state->side_length / 2.0f)) + 2;
+static bool kernel_benchmark_run(AppState* state) {
+    BenchmarkReport* report = &state->benchmark;
+    report->kernel_results = 0;
+    report->kernel_regressions = 0;
+    report->kernel_baseline_saved = false;
+    // The idle render worker's region holds the results and the orbit kernel's tables
+    arena_reset(&state->worker.arena);
+    KernelResults* results = arena_alloc(&state->worker.arena, sizeof(KernelResults));
+    KernelResults* baseline = arena_alloc(&state->worker.arena, sizeof(KernelResults));
+    if(results == NULL || baseline == NULL) {
+        arena_reset(&state->worker.arena);
+        return false;
+    }
     
-    int full_triangles = 0;
-    int partial_triangles = 0;
-    int triangle_area = 0;
-    int line_count = 0;
+    int seed_count = state->seed_count;
+    uint32_t random_seed = state->random_seed;
+    state->seed_count = DEFAULT_SEED_COUNT;
+    state->random_seed = BENCHMARK_RANDOM_SEED;
+    Point origin = {0, 0};
+    uint32_t samples[KERNEL_RUNS];
+    bool built = true;
     
-    // Draw lines by type to avoid duplicates
-    if(state->show_lines) {
-        // Draw all vertical lines (left edges of right-pointing triangles)
-        for(int col = 0; col <= num_cols; col++) {
-            int x = (int)(col * h);
-            if(x >= 0 && x < SCREEN_WIDTH) {
-                canvas_draw_line(canvas, x, 0, x, SCREEN_HEIGHT - 1);
-                line_count++;
+    memset(results, 0xFF, sizeof(KernelResults));
+    for(int pass = 0; pass < KERNEL_PASSES && built; pass++) {
+        for(int i = 0; i < LATTICE_TABLE_SIZE_COUNT; i++) {
+            int a = MIN_SIDE_LENGTH + i * SIDE_LENGTH_STEP;
+            built = geometry_build_into(
+                &state->lattice, &state->symmetry, &state->orbits, &state->geometry_arena, a, SymmetryP3m1, origin);
+            if(!built) break;
+            seeds_regenerate(state);
+            tile_build(&state->tile, &state->lattice, &state->symmetry, true, true);
+            memset(state->frame, 0, FRAME_SIZE);
+            
+            for(int kernel = 0; kernel < KernelCount; kernel++) {
+                // The first run sizes the samples, an untimed one of that size warms up the caches
+                uint32_t cycles = kernel_run(state, kernel, 1) / KERNEL_CYCLE_SCALE;
+                int repeats = (int)(KERNEL_SAMPLE_CYCLES / MAX(cycles, 1u)) + 1;
+                kernel_run(state, kernel, repeats);
+                for(int run = 0; run < KERNEL_RUNS; run++) {
+                    samples[run] = kernel_run(state, kernel, repeats);
+                }
+                benchmark_sort(samples, KERNEL_RUNS);
+                results->cycles[kernel][i] = MIN(results->cycles[kernel][i], samples[0]);
             }
         }
-        
-        // Draw diagonal lines (only from right-pointing triangles to avoid duplicates)
-        for(int col = 0; col < num_cols; col++) {
-            for(int row = -num_rows; row < num_rows; row++) {
-                bool pointing_right = ((col + row) % 2 == 0);
-                if(!pointing_right) continue; // Only process right-pointing triangles
-                
-                Point vertices[3];
-                get_triangle_vertices(vertices, col, row, state->side_length, pointing_right);
-                
-                if(!is_triangle_visible(vertices)) continue;
-                
-                // Draw the two diagonal edges of the right-pointing triangle
-                // Upper diagonal: from top vertex to right apex
-                canvas_draw_line(canvas, vertices[0].x, vertices[0].y, vertices[2].x, vertices[2].y);
-                line_count++;
-                
-                // Lower diagonal: from bottom vertex to right apex
-                canvas_draw_line(canvas, vertices[1].x, vertices[1].y, vertices[2].x, vertices[2].y);
-                line_count++;
-            }
+    }
+    state->seed_count = seed_count;
+    state->random_seed = random_seed;
+    
+    if(built) {
+        bool compared = saved_struct_load(
+            KERNEL_BASELINE_PATH, baseline, sizeof(KernelResults), KERNEL_BASELINE_MAGIC, KERNEL_BASELINE_VERSION);
+        if(!kernel_results_write(results, compared ? baseline : NULL, report)) {
+            FURI_LOG_W(TAG, "Kernel results not written");
+        }
+        if(!compared) {
+            report->kernel_baseline_saved = saved_struct_save(
+                KERNEL_BASELINE_PATH, results, sizeof(KernelResults), KERNEL_BASELINE_MAGIC, KERNEL_BASELINE_VERSION);
         }
+        report->kernel_results = KernelCount * LATTICE_TABLE_SIZE_COUNT;
+        FURI_LOG_I(TAG, "Kernels: %d results, %d over +%d%%%s", report->kernel_results, report->kernel_regressions,
+                   KERNEL_REGRESSION_PERCENT, report->kernel_baseline_saved ? ", saved as baseline" : "");
     }
     
-    // Count triangles and draw centers
-    for(int col = 0; col < num_cols; col++) {
-        for(int row = -num_rows; row < num_rows; row++) {
-            bool pointing_right = ((col + row) % 2 == 0);
-            
-            Point vertices[3];
-            get_triangle_vertices(vertices, col, row, state->side_length, pointing_right);
-            
-            if(!is_triangle_visible(vertices)) continue;
+    arena_reset(&state->worker.arena);
+    return built;
+}
+
+/**
+ * Sweep every side length with lines and centers on and off and time draw_pattern()
+ *
+ * Every configuration renders BENCHMARK_FRAMES frames. The per configuration numbers go to
+ * the log, the overall result and the slowest configuration are kept for the report screen.
+ * The settings the app was started with are restored afterwards, also when a build fails
+ * partway through.
+ *
+ * @return false if the lattice could not be built
+ */
+static bool benchmark_run(AppState* state) {
+    int side_length = state->side_length;
+    bool show_lines = state->show_lines;
+    bool show_info = state->show_info;
+    uint32_t random_seed = state->random_seed;
+    uint32_t cycles_per_us = furi_hal_cortex_instructions_per_microsecond();
+    uint32_t samples[BENCHMARK_FRAMES];
+    BenchmarkReport* report = &state->benchmark;
+    
+    state->random_seed = BENCHMARK_RANDOM_SEED;
+    memset(report, 0, sizeof(BenchmarkReport));
+    report->min_us = UINT32_MAX;
+    FURI_LOG_I(TAG, "Benchmark: %d frames per configuration, mode %s, group %s", BENCHMARK_FRAMES,
+               render_mode_names[state->render_mode], symmetry_groups[state->symmetry_group].name);
+    
+    // A failed build stops the run, the settings below are restored either way
+    bool built = true;
+    for(int a = MIN_SIDE_LENGTH; a <= MAX_SIDE_LENGTH; a += SIDE_LENGTH_STEP) {
+        state->side_length = a;
+        built = geometry_build(state);
+        if(!built) break;
+        seeds_regenerate(state);
+        
+        for(int config = 0; config < 4; config++) {
+            state->show_lines = (config & 1) != 0;
+            state->show_info = (config & 2) != 0;
             
-            // Classify triangle as full or partial
-            if(is_triangle_fully_visible(vertices)) {
-                full_triangles++;
-            } else {
-                partial_triangles++;
+            for(int i = 0; i < BENCHMARK_FRAMES; i++) {
+                samples[i] = benchmark_frame_cycles(state) / cycles_per_us;
             }
+            benchmark_sort(samples, BENCHMARK_FRAMES);
+            uint32_t median = samples[BENCHMARK_FRAMES / 2];
             
-            // Calculate area (only once, all triangles are same size)
-            if(triangle_area == 0) {
-                triangle_area = calculate_triangle_area(vertices);
-            }
+            FURI_LOG_I(TAG,
+                       "a:%d lines:%d centers:%d min:%" PRIu32 "us med:%" PRIu32 "us max:%" PRIu32 "us",
+                       a, state->show_lines, state->show_info, samples[0], median,
+                       samples[BENCHMARK_FRAMES - 1]);
             
-            // Draw center point if enabled
-            if(state->show_info) {
-                Point center = get_triangle_center(vertices);
-                if(center.x >= 0 && center.x < SCREEN_WIDTH && 
-                   center.y >= 0 && center.y < SCREEN_HEIGHT) {
-                    canvas_draw_disc(canvas, center.x, center.y, 1);
-                }
+            report->min_us = MIN(report->min_us, samples[0]);
+            report->max_us = MAX(report->max_us, samples[BENCHMARK_FRAMES - 1]);
+            if(median >= report->worst_median_us) {
+                report->worst_median_us = median;
+                report->worst_side_length = a;
+                report->worst_config = config;
             }
+            report->median_sum_us += median;
+            report->configurations++;
         }
+        
+        // Show the pattern that is being measured
+        snapshot_publish(state);
+        frame_show(state);
     }
     
-    // Draw debug info if enabled
-    if(state->show_info) {
-        char debug_str[64];
-        snprintf(debug_str, sizeof(debug_str), "a:%d L:%d T:%d(+%d) A:%dpx", 
-                 state->side_length, line_count, full_triangles, partial_triangles, triangle_area);
+    if(built) {
+        FURI_LOG_I(TAG,
+                   "Benchmark: min:%" PRIu32 "us max:%" PRIu32 "us worst median:%" PRIu32 "us at a:%d",
+                   report->min_us, report->max_us, report->worst_median_us,
+                   report->worst_side_length);
         
-        // Draw white background for text
-        canvas_set_color(canvas, ColorWhite);
-        canvas_draw_box(canvas, 0, 0, SCREEN_WIDTH, 10);
-        
-        // Draw text in black
-        canvas_set_color(canvas, ColorBlack);
-        canvas_draw_str(canvas, 2, 8, debug_str);
+        // A failed kernel run only leaves its line of the report empty
+        kernel_benchmark_run(state);
     }
+    
+    state->side_length = side_length;
+    state->show_lines = show_lines;
+    state->show_info = show_info;
+    state->random_seed = random_seed;
+    if(!geometry_build(state)) return false;
+    seeds_regenerate(state);
+    state->frame_dirty = true;
+    state->benchmark_open = built;
+    return built;
 }
 
 /**
- * Canvas render callback
+ * View port input callback, runs in the GUI thread
+ *
+ * Never blocks: the main loop drains the queue in batches, so it only fills up if the main
+ * loop is stuck, and then dropping events is better than stalling every other input user.
  */
-static void render_callback(Canvas* canvas, void* ctx) {
-    AppState* state = (AppState*)ctx;
-    canvas_clear(canvas);
-    canvas_set_color(canvas, ColorBlack);
+static void input_callback(InputEvent* input_event, void* ctx) {
+    furi_assert(ctx);
+    AppState* state = ctx;
+    if(atomic_load(&state->direct_active)) return;
+    AppEvent event = {.type = AppEventTypeInput, .input = *input_event};
+#ifdef KARL_EIDO_TELEMETRY
+    event.cycles = DWT->CYCCNT | 1; // Never 0, which means no pending input
+#endif
+    furi_message_queue_put(state->event_queue, &event, 0);
+}
+
+/**
+ * Input events pubsub callback, runs in the input service thread
+ *
+ * Only forwards events while direct draw is active, the view port gets them otherwise.
+ */
+static void input_events_callback(const void* value, void* ctx) {
+    AppState* state = ctx;
+    if(!atomic_load(&state->direct_active)) return;
+    AppEvent event = {.type = AppEventTypeInput, .input = *(const InputEvent*)value};
+#ifdef KARL_EIDO_TELEMETRY
+    event.cycles = DWT->CYCCNT | 1; // Never 0, which means no pending input
+#endif
+    furi_message_queue_put(state->event_queue, &event, 0);
+}
+
+/**
+ * Animation timer callback, runs in the timer thread
+ *
+ * Frame pacing: a tick is only queued when the frame of the previous one has been drawn,
+ * so redraws never pile up. A frame that was never drawn (e.g. the view port was hidden)
+ * stops blocking the timer after ANIMATION_STALL_MS.
+ */
+static void animation_timer_callback(void* ctx) {
+    AppState* state = ctx;
+    uint32_t now = furi_get_tick();
+    
+    if(atomic_exchange(&state->frame_pending, true)) {
+        if(now - state->frame_pending_since < furi_ms_to_ticks(ANIMATION_STALL_MS)) {
+            state->frames_skipped++;
+            return;
+        }
+    }
+    state->frame_pending_since = now;
     
-    draw_pattern(canvas, state);
+    AppEvent event = {.type = AppEventTypeTick};
+    if(furi_message_queue_put(state->event_queue, &event, 0) != FuriStatusOk) {
+        atomic_store(&state->frame_pending, false);
+    }
 }
 
 /**
- * Input event callback
+ * Bitplane timer callback, runs in the timer thread
+ *
+ * Counts the flip and asks the GUI for a redraw: the render callback picks the plane of the
+ * count from the published snapshot, so flipping planes costs one frame copy and never wakes
+ * the main loop.
  */
-static void input_callback(InputEvent* input_event, void* ctx) {
-    furi_assert(ctx);
-    FuriMessageQueue* event_queue = ctx;
-    furi_message_queue_put(event_queue, input_event, FuriWaitForever);
+static void gray_timer_callback(void* ctx) {
+    AppState* state = ctx;
+    atomic_fetch_add_explicit(&state->gray_tick, 1, memory_order_relaxed);
+    view_port_update(state->view_port);
+}
+
+/**
+ * Pan direction of an arrow key, (0, 0) for the other keys
+ */
+static Point pan_key_direction(InputKey key) {
+    Point direction = {.x = 0, .y = 0};
+    if(key == InputKeyUp) direction.y = -1;
+    if(key == InputKeyDown) direction.y = 1;
+    if(key == InputKeyLeft) direction.x = -1;
+    if(key == InputKeyRight) direction.x = 1;
+    return direction;
 }
 
 /**
  * Handle input events and update application state
+ *
+ * Seed changes are applied to the persistent frame right away, every other change marks it
+ * dirty so that it is rendered from scratch before the next redraw.
+ *
+ * @return true if the screen has to be redrawn
  */
 static bool handle_input(InputEvent* event, AppState* state) {
-    if(event->type != InputTypePress && event->type != InputTypeRepeat && event->type != InputTypeLong) {
+    // The zoom runs until its key is let go, wherever the other input goes meanwhile
+    if(state->zoom.direction && event->type == InputTypeRelease &&
+       event->key == (state->zoom.direction > 0 ? InputKeyUp : InputKeyDown)) {
+        zoom_stop(state);
+        return true;
+    }
+    // So does a pan
+    Point key_direction = pan_key_direction(event->key);
+    if((state->pan_direction.x != 0 || state->pan_direction.y != 0) && event->type == InputTypeRelease &&
+       key_direction.x == state->pan_direction.x && key_direction.y == state->pan_direction.y) {
+        state->pan_direction.x = 0;
+        state->pan_direction.y = 0;
+        return false;
+    }
+    
+    if(event->type != InputTypePress && event->type != InputTypeRepeat &&
+       event->type != InputTypeLong && event->type != InputTypeShort) {
         return false;
     }
     
+    if(state->benchmark_open) {
+        // Any short press closes the report, the Back key held at startup only sends a release
+        if(event->type != InputTypeShort) return false;
+        state->benchmark_open = false;
+        return true;
+    }
+    
+    if(state->menu_open) {
+        return handle_menu_input(event, state);
+    }
+    
+    if(state->pan_keys && (key_direction.x != 0 || key_direction.y != 0)) {
+        // A press pans one step at once, holding the key keeps panning with the animation timer
+        if(event->type != InputTypePress) return false;
+        state->pan_direction = key_direction;
+        int step = pan_step(state);
+        return pan_move(state, key_direction.x * step, key_direction.y * step);
+    }
+    
     bool state_changed = false;
     
     switch(event->key) {
         case InputKeyUp:
-            if(event->type == InputTypePress || event->type == InputTypeRepeat) {
+            if(state->smooth_zoom) {
+                if(event->type == InputTypePress) zoom_start(state, 1);
+            } else if(event->type == InputTypePress || event->type == InputTypeRepeat) {
                 if(state->side_length < MAX_SIDE_LENGTH) {
                     state->side_length += SIDE_LENGTH_STEP;
+                    state->frame_dirty = true;
                     state_changed = true;
                 }
             }
             break;
             
         case InputKeyDown:
-            if(event->type == InputTypePress || event->type == InputTypeRepeat) {
+            if(state->smooth_zoom) {
+                if(event->type == InputTypePress) zoom_start(state, -1);
+            } else if(event->type == InputTypePress || event->type == InputTypeRepeat) {
                 if(state->side_length > MIN_SIDE_LENGTH) {
                     state->side_length -= SIDE_LENGTH_STEP;
+                    state->frame_dirty = true;
+                    state_changed = true;
+                }
+            }
+            break;
+            
+        case InputKeyRight:
+            if(event->type == InputTypePress || event->type == InputTypeRepeat) {
+                if(seed_add(state)) {
+                    int seed = state->seed_count - 1;
+                    seed_toggle(state, seed, state->seeds[seed]);
+                    state_changed = true;
+                }
+            }
+            break;
+            
+        case InputKeyLeft:
+            if(event->type == InputTypePress || event->type == InputTypeRepeat) {
+                if(state->seed_count > 0) {
+                    state->seed_count--;
+                    seed_toggle(state, state->seed_count, state->seeds[state->seed_count]);
+                    seed_bits_flip(state, state->seeds[state->seed_count]);
                     state_changed = true;
                 }
             }
@@ -283,16 +4177,32 @@ static bool handle_input(InputEvent* event, AppState* state) {
             if(event->type == InputTypeLong) {
                 // Toggle line display
                 state->show_lines = !state->show_lines;
+                layers_invalidate(state, RenderLayerLines);
                 state_changed = true;
             } else if(event->type == InputTypePress) {
                 // Toggle debug info and center points together
+#ifdef KARL_EIDO_PROFILE
+                // The profiling page comes after the info line
+                if(state->show_info && !state->show_profile) {
+                    state->show_profile = true;
+                    state_changed = true;
+                    break;
+                }
+                state->show_profile = false;
+#endif
                 state->show_info = !state->show_info;
+                layers_invalidate(state, RenderLayerCenters);
                 state_changed = true;
             }
             break;
             
         case InputKeyBack:
-            state->running = false;
+            if(event->type == InputTypeLong) {
+                state->menu_open = true;
+                state_changed = true;
+            } else if(event->type == InputTypeShort) {
+                state->running = false;
+            }
             break;
             
         default:
@@ -302,28 +4212,435 @@ static bool handle_input(InputEvent* event, AppState* state) {
     return state_changed;
 }
 
+/**
+ * Run the job the main thread handed over, a geometry rebuild or a frame render
+ *
+ * Called by the render worker thread; the host harness calls it directly to measure its stack.
+ */
+static void render_worker_run(RenderWorker* worker) {
+    if(worker->work == RenderWorkGeometry) {
+        PROFILE_BEGIN();
+        worker->geometry_built = geometry_build_into(
+            &worker->lattice, &worker->symmetry, &worker->orbits, &worker->arena, worker->side_length,
+            worker->group, worker->origin);
+        PROFILE_END(&worker->profile, ProfileStageGrid);
+    } else if(worker->work == RenderWorkFrame) {
+        render_layers_update(&worker->layers, &worker->job);
+        for(int plane = 0; plane < worker->job.gray_planes; plane++) {
+            render_layers_compose(&worker->layers, worker->frames[plane], plane);
+        }
+    }
+}
+
+/**
+ * Render worker thread: runs the job the main thread handed over and reports back
+ */
+static int32_t render_worker_thread(void* ctx) {
+    AppState* state = ctx;
+    RenderWorker* worker = &state->worker;
+    
+    while(true) {
+        uint32_t flags = furi_thread_flags_wait(
+            RenderWorkerFlagJob | RenderWorkerFlagExit, FuriFlagWaitAny, FuriWaitForever);
+        if(flags & FuriFlagError) continue;
+        if(flags & RenderWorkerFlagExit) break;
+        
+#ifdef KARL_EIDO_TELEMETRY
+        uint32_t job_start = DWT->CYCCNT;
+        render_worker_run(worker);
+        telemetry_record(
+            (worker->work == RenderWorkGeometry) ? &state->telemetry.rebuild : &state->telemetry.render,
+            DWT->CYCCNT - job_start);
+#else
+        render_worker_run(worker);
+#endif
+        
+        // The main loop may be busy with a burst of input, keep trying unless asked to exit
+        AppEvent event = {.type = AppEventTypeRendered};
+        while(furi_message_queue_put(state->event_queue, &event, furi_ms_to_ticks(RENDER_WORKER_POST_MS)) !=
+              FuriStatusOk) {
+            if(furi_thread_flags_get() & RenderWorkerFlagExit) return 0;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Hand the next job to the render worker if it is idle
+ *
+ * A new side length or symmetry group is built first, and so is a pan the frames cannot
+ * show with the front geometry where it is, see pan_exact(); anything else only renders the
+ * frames again. Runs once per batch of events and after every finished job, so a burst of
+ * Up/Down repeats costs one rebuild per job the worker gets through.
+ */
+static void render_worker_schedule(AppState* state) {
+    RenderWorker* worker = &state->worker;
+    // The zoom preview owns the frames until the zoom stops
+    if(worker->work != RenderWorkIdle || state->zoom.direction) return;
+    
+    // Geometry and orbits only depend on the side length, the symmetry group and the origin
+    Point origin = pan_origin(state);
+    bool moved = state->lattice.origin.x != origin.x || state->lattice.origin.y != origin.y;
+    if(state->orbits.side_length != state->side_length || state->orbits.group != state->symmetry_group ||
+       (moved && !pan_exact(state))) {
+        worker->side_length = state->side_length;
+        worker->group = state->symmetry_group;
+        worker->origin = origin;
+        worker->work = RenderWorkGeometry;
+    } else if(state->frame_dirty) {
+        render_job_init(&worker->job, state);
+        worker->job.tile = &worker->tile;
+#ifdef KARL_EIDO_PROFILE
+        worker->job.profile = &worker->profile;
+#endif
+        worker->job.layers = state->layers_dirty;
+        worker->work = RenderWorkFrame;
+        state->frame_dirty = false;
+        state->layers_dirty = 0;
+    } else {
+        return;
+    }
+    furi_thread_flags_set(furi_thread_get_id(worker->thread), RenderWorkerFlagJob);
+}
+
+/**
+ * Take over the result of the finished job
+ *
+ * A new geometry is swapped in together with its arena region and gets new seeds, unless
+ * only its origin moved: the pattern is the same then and the seeds move along. Rendered
+ * frames get the seed changes made while the worker was busy, the seeds are XORed in so
+ * the difference is enough, and are shifted by the pan since the geometry was built.
+ *
+ * @return true if the screen has to be redrawn
+ */
+static bool render_worker_finish(AppState* state) {
+    RenderWorker* worker = &state->worker;
+    RenderWork work = worker->work;
+    worker->work = RenderWorkIdle;
+#ifdef KARL_EIDO_PROFILE
+    profile_merge(&state->profile, &worker->profile);
+#endif
+    
+    if(work == RenderWorkGeometry) {
+        if(!worker->geometry_built) {
+            // Stay with the geometry there is and the settings it was built for
+            FURI_LOG_W(TAG, "Geometry for a:%d not built", worker->side_length);
+            state->geometry_peak = MAX(state->geometry_peak, worker->arena.peak);
+            arena_reset(&worker->arena);
+            state->side_length = state->orbits.side_length;
+            state->symmetry_group = state->orbits.group;
+            state->pan = state->lattice.origin;
+            state->frame_dirty = true;
+            return false;
+        }
+        bool panned = worker->side_length == state->orbits.side_length && worker->group == state->orbits.group &&
+                      worker->orbits.base_count == state->orbits.base_count;
+        Point from = state->lattice.origin;
+        
+        // The regions swap with the geometry they hold
+        LatticeCache lattice = state->lattice;
+        Symmetry symmetry = state->symmetry;
+        OrbitTable orbits = state->orbits;
+        Arena arena = state->geometry_arena;
+        state->lattice = worker->lattice;
+        state->symmetry = worker->symmetry;
+        state->orbits = worker->orbits;
+        state->geometry_arena = worker->arena;
+        worker->lattice = lattice;
+        worker->symmetry = symmetry;
+        worker->orbits = orbits;
+        worker->arena = arena;
+        orbit_table_clear(&worker->orbits);
+        lattice_cache_clear(&worker->lattice);
+        arena_reset(&worker->arena);
+        state->geometry_peak = MAX(state->geometry_peak, worker->arena.peak);
+        
+        if(panned) {
+            // Base pixels are numbered the same at every origin, the frames just miss the strips panned in
+            for(int i = 0; i < state->seed_count; i++) {
+                state->motion[i].x += (state->lattice.origin.x - from.x) * (1 << MOTION_SHIFT);
+                state->motion[i].y += (state->lattice.origin.y - from.y) * (1 << MOTION_SHIFT);
+            }
+            layers_invalidate(state, RenderLayerAll);
+            return false;
+        }
+        seeds_regenerate(state);
+        layers_invalidate(state, RenderLayerAll);
+        state->frame_stale = true;
+        return false;
+    }
+    if(work != RenderWorkFrame) return false;
+    if(state->zoom.direction) {
+        // Started before the zoom, rendered again once it stops
+        state->frame_dirty = true;
+        return false;
+    }
+    
+    const RenderJob* job = &worker->job;
+    int count = MAX(job->seed_count, state->seed_count);
+    for(int i = 0; i < count; i++) {
+        int rendered = (i < job->seed_count) ? job->seeds[i] : -1;
+        int current = (i < state->seed_count) ? state->seeds[i] : -1;
+        if(rendered == current) continue;
+        
+        int level = seed_level(i, job->gray_planes);
+        for(int plane = 0; plane < level; plane++) {
+            if(rendered >= 0) frame_toggle_seed(worker->frames[plane], &state->orbits, rendered);
+            if(current >= 0) frame_toggle_seed(worker->frames[plane], &state->orbits, current);
+        }
+    }
+    
+    for(int plane = 0; plane < job->gray_planes; plane++) {
+        memcpy(plane_frame(state, plane), worker->frames[plane], FRAME_SIZE);
+    }
+    state->frame_planes = job->gray_planes;
+    state->frame_stale = false;
+    
+    // Panned on while the frames were rendered
+    Point offset = pan_offset(state);
+    if(offset.x != 0 || offset.y != 0) frames_shift(state, offset.x, offset.y);
+    return true;
+}
+
+/**
+ * Handle one event from the queue
+ *
+ * @return true if the screen has to be redrawn
+ */
+static bool app_event_handle(AppState* state, AppEvent* event) {
+    if(event->type == AppEventTypeRendered) {
+        return render_worker_finish(state);
+    }
+#ifdef KARL_EIDO_TELEMETRY
+    if(event->type == AppEventTypeTelemetry) {
+        telemetry_dump(&state->telemetry, state->frames_skipped);
+        return false;
+    }
+#endif
+    if(event->type == AppEventTypeTick) {
+        bool redraw;
+        if(state->zoom.direction) {
+            redraw = zoom_step(state);
+        } else {
+            int step = pan_step(state);
+            redraw = pan_move(state, state->pan_direction.x * step, state->pan_direction.y * step);
+            redraw |= animation_step(state);
+        }
+        if(!redraw) atomic_store(&state->frame_pending, false);
+        return redraw;
+    }
+    
+    bool redraw = handle_input(&event->input, state);
+    animation_timer_update(state);
+    gray_timer_update(state);
+    direct_draw_update(state);
+    return redraw;
+}
+
+/**
+ * Account one wakeup of the main loop and the time it waited before it
+ *
+ * Closes the idle window once IDLE_WINDOW_MS have passed. Without events the loop sleeps,
+ * so a window can be much longer than that; its figures are what the overlay shows.
+ */
+static void idle_stats_update(AppState* state, uint32_t wait_start, uint32_t wait_end) {
+    state->idle_ticks += wait_end - wait_start;
+    state->wakeups++;
+    
+    uint32_t elapsed = wait_end - state->idle_window_start;
+    if(elapsed < furi_ms_to_ticks(IDLE_WINDOW_MS)) return;
+    
+    uint32_t frequency = furi_kernel_get_tick_frequency();
+    state->idle_percent = (int)((uint64_t)state->idle_ticks * 100 / elapsed);
+    state->wakeups_per_10s = (int)((uint64_t)state->wakeups * frequency * 10 / elapsed);
+    state->idle_window_start = wait_end;
+    state->idle_ticks = 0;
+    state->wakeups = 0;
+}
+
+/**
+ * Restore the settings of the last session, keeps the defaults if there are none
+ *
+ * Seeds are only copied here, settings_apply_seeds() checks them once the orbit table for
+ * the restored side length exists.
+ *
+ * @return true if settings were restored
+ */
+static bool settings_load(AppState* state) {
+    AppSettings settings;
+    if(!saved_struct_load(SETTINGS_PATH, &settings, sizeof(settings), SETTINGS_MAGIC, SETTINGS_VERSION)) {
+        return false;
+    }
+    
+    if(settings.side_length >= MIN_SIDE_LENGTH && settings.side_length <= MAX_SIDE_LENGTH &&
+       (settings.side_length - MIN_SIDE_LENGTH) % SIDE_LENGTH_STEP == 0) {
+        state->side_length = settings.side_length;
+    }
+    state->show_lines = (settings.flags & SettingsFlagLines) != 0;
+    state->show_info = (settings.flags & SettingsFlagInfo) != 0;
+    state->direct_draw = (settings.flags & SettingsFlagDirect) != 0;
+    state->smooth_zoom = (settings.flags & SettingsFlagSmoothZoom) != 0;
+    state->pan_keys = (settings.flags & SettingsFlagPanKeys) != 0;
+    if(settings.render_mode < RenderModeCount) state->render_mode = settings.render_mode;
+    if(settings.symmetry_group < SymmetryCount) state->symmetry_group = settings.symmetry_group;
+    state->gray_planes = CLAMP(settings.gray_planes, GRAY_MAX_PLANES, 1);
+    if(settings.animation_mode < AnimationCount) state->animation_mode = settings.animation_mode;
+    state->animation_fps = CLAMP(settings.animation_fps, MAX_ANIMATION_FPS, MIN_ANIMATION_FPS);
+    state->export_next = MIN(settings.export_next, EXPORT_MAX_FILES);
+    state->random_seed = settings.random_seed;
+    state->random_state = settings.random_state ? settings.random_state : 1;
+    
+    state->seed_count = MIN(settings.seed_count, MAX_SEEDS);
+    memcpy(state->seeds, settings.seeds, sizeof(uint16_t) * state->seed_count);
+    return true;
+}
+
+/**
+ * Drop restored seeds that do not fit the orbit table and set up their motion
+ */
+static void settings_apply_seeds(AppState* state) {
+    int count = state->seed_count;
+    state->seed_count = 0;
+    memset(state->seed_bits, 0, sizeof(state->seed_bits));
+    for(int i = 0; i < count; i++) {
+        uint16_t seed = state->seeds[i];
+        if(seed >= state->orbits.base_count || seed_bits_test(state, seed)) continue;
+        
+        state->seeds[state->seed_count] = seed;
+        seed_bits_flip(state, seed);
+        seed_motion_init(state, state->seed_count++);
+    }
+}
+
+/**
+ * Save the settings for the next session
+ */
+static bool settings_save(const AppState* state) {
+    AppSettings settings;
+    memset(&settings, 0, sizeof(settings));
+    settings.side_length = (uint8_t)state->side_length;
+    settings.flags = (state->show_lines ? SettingsFlagLines : 0) | (state->show_info ? SettingsFlagInfo : 0) |
+                     (state->direct_draw ? SettingsFlagDirect : 0) | (state->smooth_zoom ? SettingsFlagSmoothZoom : 0) |
+                     (state->pan_keys ? SettingsFlagPanKeys : 0);
+    settings.render_mode = (uint8_t)state->render_mode;
+    settings.symmetry_group = (uint8_t)state->symmetry_group;
+    settings.gray_planes = (uint8_t)state->gray_planes;
+    settings.animation_mode = (uint8_t)state->animation_mode;
+    settings.animation_fps = (uint8_t)state->animation_fps;
+    settings.seed_count = (uint8_t)state->seed_count;
+    settings.export_next = (uint16_t)state->export_next;
+    settings.random_seed = state->random_seed;
+    settings.random_state = state->random_state;
+    memcpy(settings.seeds, state->seeds, sizeof(uint16_t) * state->seed_count);
+    
+    Storage* storage = furi_record_open(RECORD_STORAGE);
+    storage_simply_mkdir(storage, DATA_DIRECTORY);
+    furi_record_close(RECORD_STORAGE);
+    
+    bool saved = saved_struct_save(SETTINGS_PATH, &settings, sizeof(settings), SETTINGS_MAGIC, SETTINGS_VERSION);
+    if(!saved) FURI_LOG_W(TAG, "Settings not saved");
+    return saved;
+}
+
 /**
  * Main application entry point
  * Entry point name must match application.fam: entry_point="karl_main"
  */
 int32_t karl_main(void* p) {
     UNUSED(p);
+    uint32_t startup_cycles = DWT->CYCCNT;
     
-    // Initialize application state
-    AppState* state = malloc(sizeof(AppState));
-    if(state == NULL) {
+    // One block for everything the app allocates itself: the state and two geometry regions,
+    // front and back, so a rebuild never allocates
+    size_t memory_size = ARENA_ALIGN(sizeof(AppState)) + 2 * GEOMETRY_ARENA_SIZE;
+    uint8_t* memory = malloc(memory_size);
+    if(memory == NULL) {
         return -1; // Failed to allocate memory
     }
+    Arena arena;
+    arena_init(&arena, memory, memory_size);
+    AppState* state = arena_alloc(&arena, sizeof(AppState));
+    uint8_t* front_region = arena_alloc(&arena, GEOMETRY_ARENA_SIZE);
+    uint8_t* back_region = arena_alloc(&arena, GEOMETRY_ARENA_SIZE);
+    FURI_LOG_I(TAG, "Memory: %u bytes, %u per geometry region", (unsigned)memory_size, (unsigned)GEOMETRY_ARENA_SIZE);
     
     state->side_length = MAX_SIDE_LENGTH;
     state->show_lines = true;
     state->show_info = false;
     state->running = true;
+    state->render_mode = RenderModeLattice;
+    state->symmetry_group = SymmetryP3m1;
+    state->gray_planes = 1;
+    state->frame_planes = 1;
+    state->frame_stale = false;
+    atomic_init(&state->gray_tick, 0);
+    state->snapshot_generation = 0;
+    atomic_init(&state->shown_generation, 0);
+    state->menu_open = false;
+    state->menu_item = MenuItemRender;
+    state->animation_mode = AnimationOff;
+    state->animation_fps = DEFAULT_ANIMATION_FPS;
+    state->direct_draw = false;
+    state->smooth_zoom = false;
+    memset(&state->zoom, 0, sizeof(Zoom));
+    state->pan_keys = false;
+    memset(&state->pan, 0, sizeof(Point));
+    memset(&state->pan_direction, 0, sizeof(Point));
+    state->direct_canvas = NULL;
+    state->regenerate_next = 0;
+    state->frames_skipped = 0;
+    state->benchmark_open = false;
+    state->idle_ticks = 0;
+    state->wakeups = 0;
+    state->idle_percent = 0;
+    state->wakeups_per_10s = 0;
+    memset(&state->info_text, 0, sizeof(InfoText));
+    state->export_format = ExportFormatPbm;
+    state->export_next = 0;
+    state->export_result = EXPORT_NONE;
+    memset(&state->benchmark, 0, sizeof(BenchmarkReport));
+#ifdef KARL_EIDO_PROFILE
+    state->show_profile = false;
+    memset(&state->profile, 0, sizeof(ProfileStats));
+    atomic_init(&state->text_cycles, 0);
+#endif
+    atomic_init(&state->frame_pending, false);
+    atomic_init(&state->direct_active, false);
+    atomic_init(&state->snapshot_published, 0);
+    atomic_init(&state->snapshots[0].sequence, 0);
+    atomic_init(&state->snapshots[1].sequence, 0);
+    state->seed_count = DEFAULT_SEED_COUNT;
+    state->random_seed = furi_hal_random_get();
+    random_reset(state);
+    bool restored = settings_load(state);
+    
+    memset(&state->lattice, 0, sizeof(LatticeCache));
+    memset(&state->orbits, 0, sizeof(OrbitTable));
+    memset(&state->worker, 0, sizeof(RenderWorker));
+    state->worker.work = RenderWorkIdle;
+    arena_init(&state->geometry_arena, front_region, GEOMETRY_ARENA_SIZE);
+    arena_init(&state->worker.arena, back_region, GEOMETRY_ARENA_SIZE);
+    state->geometry_peak = 0;
+    atomic_init(&state->stack_free_gui, 0);
+    state->startup_cycles = startup_cycles;
+    atomic_init(&state->first_frame_cycles, 0);
+    if(!geometry_build(state)) {
+        free(memory);
+        return -1;
+    }
+    if(restored) {
+        settings_apply_seeds(state);
+    } else {
+        seeds_regenerate(state);
+    }
+    pattern_render(state);
+    state->frame_dirty = false;
+    snapshot_publish(state);
     
     // Create event queue
-    FuriMessageQueue* event_queue = furi_message_queue_alloc(8, sizeof(InputEvent));
+    FuriMessageQueue* event_queue = furi_message_queue_alloc(EVENT_QUEUE_SIZE, sizeof(AppEvent));
     if(event_queue == NULL) {
-        free(state);
+        free(memory);
         return -1;
     }
     
@@ -331,33 +4648,139 @@ int32_t karl_main(void* p) {
     ViewPort* view_port = view_port_alloc();
     if(view_port == NULL) {
         furi_message_queue_free(event_queue);
-        free(state);
+        free(memory);
         return -1;
     }
     
+    state->event_queue = event_queue;
+    state->view_port = view_port;
+    state->animation_timer = furi_timer_alloc(animation_timer_callback, FuriTimerTypePeriodic, state);
+    state->animation_period = 0;
+    state->gray_timer = furi_timer_alloc(gray_timer_callback, FuriTimerTypePeriodic, state);
+#ifdef KARL_EIDO_TELEMETRY
+    memset(&state->telemetry, 0, sizeof(Telemetry));
+    state->telemetry.timer = furi_timer_alloc(telemetry_timer_callback, FuriTimerTypePeriodic, event_queue);
+    furi_timer_start(state->telemetry.timer, furi_ms_to_ticks(TELEMETRY_DUMP_MS));
+#endif
+    
+    // Below the GUI and input threads, so a rebuild never holds up input or the render callback
+    state->worker.thread =
+        furi_thread_alloc_ex("KarlEidoRender", RENDER_WORKER_STACK_SIZE, render_worker_thread, state);
+    furi_thread_set_priority(state->worker.thread, FuriThreadPriorityLow);
+    furi_thread_start(state->worker.thread);
+    
     view_port_draw_callback_set(view_port, render_callback, state);
-    view_port_input_callback_set(view_port, input_callback, event_queue);
+    view_port_input_callback_set(view_port, input_callback, state);
     
     // Register viewport with GUI
     Gui* gui = furi_record_open(RECORD_GUI);
     gui_add_view_port(gui, view_port, GuiLayerFullscreen);
+    state->gui = gui;
+    state->input_events = furi_record_open(RECORD_INPUT_EVENTS);
+    state->input_subscription = furi_pubsub_subscribe(state->input_events, input_events_callback, state);
+    
+    // The first frame is drawn by the GUI thread (or was committed directly)
+    uint32_t first_frame_cycles = 0;
+    for(int i = 0; i < STARTUP_WAIT_MS; i++) {
+        first_frame_cycles = atomic_load_explicit(&state->first_frame_cycles, memory_order_relaxed);
+        if(first_frame_cycles) break;
+        furi_delay_ms(1);
+    }
+    uint32_t startup_us = first_frame_cycles / furi_hal_cortex_instructions_per_microsecond();
+    if(!first_frame_cycles) {
+        FURI_LOG_W(TAG, "Startup: no frame drawn after %dms%s", STARTUP_WAIT_MS,
+                   restored ? " (settings restored)" : "");
+    } else if(startup_us > STARTUP_BUDGET_US) {
+        FURI_LOG_W(TAG, "Startup: %" PRIu32 "us to the first frame, over the %dus budget%s", startup_us,
+                   STARTUP_BUDGET_US, restored ? " (settings restored)" : "");
+    } else {
+        FURI_LOG_I(TAG, "Startup: %" PRIu32 "us to the first frame%s", startup_us,
+                   restored ? " (settings restored)" : "");
+    }
+    export_next_find(state);
+    
+    // Back held while starting selects the benchmark (buttons are active low)
+    if(!furi_hal_gpio_read(&gpio_button_back)) {
+        direct_draw_set(state, state->direct_draw);
+        if(benchmark_run(state)) {
+            pattern_render(state);
+            state->frame_dirty = false;
+        } else {
+            state->running = false;
+        }
+        snapshot_publish(state);
+        frame_show(state);
+    }
+    
+    // A restored animation or gray mode runs right away
+    animation_timer_update(state);
+    gray_timer_update(state);
+    direct_draw_update(state);
     
-    // Main event loop
-    InputEvent event;
+    // Main event loop: sleeps until an input event or an animation tick arrives
+    AppEvent event;
+    state->idle_window_start = furi_get_tick();
     while(state->running) {
-        if(furi_message_queue_get(event_queue, &event, 100) == FuriStatusOk) {
-            if(handle_input(&event, state)) {
-                view_port_update(view_port);
+        uint32_t wait_start = furi_get_tick();
+        if(furi_message_queue_get(event_queue, &event, FuriWaitForever) == FuriStatusOk) {
+            idle_stats_update(state, wait_start, furi_get_tick());
+#ifdef KARL_EIDO_TELEMETRY
+            uint32_t batch_start = DWT->CYCCNT;
+            uint32_t input_cycles = 0; // Oldest input of the batch
+#endif
+            
+            // Coalesce everything that is pending (e.g. held Up/Down repeats) into one frame
+            bool redraw = false;
+            do {
+#ifdef KARL_EIDO_TELEMETRY
+                if(event.type == AppEventTypeInput && !input_cycles) input_cycles = event.cycles;
+#endif
+                redraw |= app_event_handle(state, &event);
+            } while(state->running && furi_message_queue_get(event_queue, &event, 0) == FuriStatusOk);
+            // Rebuilds and full renders run in the worker, the loop stays free for input
+            render_worker_schedule(state);
+            
+            if(redraw && !state->frame_stale) {
+#ifdef KARL_EIDO_TELEMETRY
+                // An input answered by a later frame (after a rebuild) is not counted
+                if(input_cycles) {
+                    atomic_store_explicit(&state->telemetry.latency_start, input_cycles, memory_order_relaxed);
+                }
+#endif
+                snapshot_publish(state);
+                frame_show(state);
+#ifdef KARL_EIDO_TELEMETRY
+                telemetry_record(&state->telemetry.frame, DWT->CYCCNT - batch_start);
+#endif
             }
         }
     }
     
-    // Cleanup
+    settings_save(state);
+    
+    // Cleanup, the worker finishes its job first
+    furi_thread_flags_set(furi_thread_get_id(state->worker.thread), RenderWorkerFlagExit);
+    furi_thread_join(state->worker.thread);
+    furi_thread_free(state->worker.thread);
+    furi_timer_stop(state->animation_timer);
+    furi_timer_free(state->animation_timer);
+    furi_timer_stop(state->gray_timer);
+    furi_timer_free(state->gray_timer);
+#ifdef KARL_EIDO_TELEMETRY
+    furi_timer_stop(state->telemetry.timer);
+    furi_timer_free(state->telemetry.timer);
+    telemetry_dump(&state->telemetry, state->frames_skipped);
+#endif
+    direct_draw_set(state, false);
+    furi_pubsub_unsubscribe(state->input_events, state->input_subscription);
+    furi_record_close(RECORD_INPUT_EVENTS);
     gui_remove_view_port(gui, view_port);
     view_port_free(view_port);
     furi_message_queue_free(event_queue);
     furi_record_close(RECORD_GUI);
-    free(state);
+    FURI_LOG_I(TAG, "Geometry peak: %u of %u bytes", (unsigned)MAX(state->geometry_peak, state->geometry_arena.peak),
+               (unsigned)GEOMETRY_ARENA_SIZE);
+    free(memory);
     
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,97 @@
+// Generated by tools/gen_lattice_tables.py, do not edit
+#pragma once
+
+#include <stdint.h>
+
+#define LATTICE_TABLE_MIN_SIDE_LENGTH 5
+#define LATTICE_TABLE_MAX_SIDE_LENGTH 63
+#define LATTICE_TABLE_SIDE_LENGTH_STEP 2
+#define LATTICE_TABLE_SIZE_COUNT 30
+
+// Geometry of one side length, arrays are slices of lattice_column_x and lattice_node_y
+typedef struct {
+    uint16_t column_offset; // column_count + 1 entries, the last one is the apex of the last column
+    uint16_t node_offset; // row_max - row_min + 3 entries, starting at node row row_min - 1
+    uint8_t column_count;
+    int8_t row_min;
+    int8_t row_max;
+    int8_t full_row_min;
+    int8_t full_row_max;
+    uint16_t full_triangles;
+    uint16_t partial_triangles;
+    uint16_t triangle_area;
+} LatticeGeometry;
+
+static const LatticeGeometry lattice_geometry[LATTICE_TABLE_SIZE_COUNT] = {
+    {0, 0, 30, -13, 13, -11, 11, 667, 143, 10}, // a=5
+    {31, 29, 22, -10, 10, -8, 8, 357, 105, 21}, // a=7
+    {54, 52, 17, -8, 8, -6, 6, 208, 81, 31}, // a=9
+    {72, 71, 14, -6, 6, -4, 4, 117, 65, 49}, // a=11
+    {87, 86, 12, -5, 5, -3, 3, 77, 55, 71}, // a=13
+    {100, 99, 10, -5, 5, -3, 3, 63, 47, 90}, // a=15
+    {111, 112, 9, -4, 4, -2, 2, 40, 41, 119}, // a=17
+    {121, 123, 8, -4, 4, -2, 2, 35, 37, 152}, // a=19
+    {130, 134, 8, -4, 4, -2, 2, 35, 37, 189}, // a=21
+    {139, 145, 7, -3, 3, -1, 1, 18, 31, 218}, // a=23
+    {147, 154, 6, -3, 3, -1, 1, 15, 27, 262}, // a=25
+    {154, 163, 6, -3, 3, -1, 1, 15, 27, 310}, // a=27
+    {161, 172, 6, -3, 3, -1, 1, 15, 27, 362}, // a=29
+    {168, 181, 5, -3, 3, -1, 1, 12, 23, 403}, // a=31
+    {174, 190, 5, -2, 2, 0, 0, 4, 21, 462}, // a=33
+    {180, 197, 5, -2, 2, 0, 0, 4, 21, 525}, // a=35
+    {186, 204, 4, -2, 2, 0, 0, 3, 17, 592}, // a=37
+    {191, 211, 4, -2, 2, 0, 0, 3, 17, 643}, // a=39
+    {196, 218, 4, -2, 2, 0, 0, 3, 17, 717}, // a=41
+    {201, 225, 4, -2, 2, 0, 0, 3, 17, 795}, // a=43
+    {206, 232, 4, -2, 2, 0, 0, 3, 17, 855}, // a=45
+    {211, 239, 4, -2, 2, 0, 0, 3, 17, 940}, // a=47
+    {216, 246, 4, -2, 2, 0, 0, 3, 17, 1029}, // a=49
+    {221, 253, 3, -2, 2, 0, 0, 2, 13, 1122}, // a=51
+    {225, 260, 3, -2, 2, 0, 0, 2, 13, 1192}, // a=53
+    {229, 267, 3, -2, 2, 0, 0, 2, 13, 1292}, // a=55
+    {233, 274, 3, -2, 2, 0, 0, 2, 13, 1396}, // a=57
+    {237, 281, 3, -2, 2, 0, 0, 2, 13, 1504}, // a=59
+    {241, 288, 3, -2, 2, 0, 0, 2, 13, 1586}, // a=61
+    {245, 295, 3, -2, 2, 0, 0, 2, 13, 1701}, // a=63
+};
+
+static const uint8_t lattice_column_x[249] = {
+    0, 4, 8, 12, 17, 21, 25, 30, 34, 38, 43, 47, 51, 56, 60, 64,
+    69, 73, 77, 82, 86, 90, 95, 99, 103, 108, 112, 116, 121, 125, 129, 0,
+    6, 12, 18, 24, 30, 36, 42, 48, 54, 60, 66, 72, 78, 84, 90, 96,
+    103, 109, 115, 121, 127, 133, 0, 7, 15, 23, 31, 38, 46, 54, 62, 70,
+    77, 85, 93, 101, 109, 116, 124, 132, 0, 9, 19, 28, 38, 47, 57, 66,
+    76, 85, 95, 104, 114, 123, 133, 0, 11, 22, 33, 45, 56, 67, 78, 90,
+    101, 112, 123, 135, 0, 12, 25, 38, 51, 64, 77, 90, 103, 116, 129, 0,
+    14, 29, 44, 58, 73, 88, 103, 117, 132, 0, 16, 32, 49, 65, 82, 98,
+    115, 131, 0, 18, 36, 54, 72, 90, 109, 127, 145, 0, 19, 39, 59, 79,
+    99, 119, 139, 0, 21, 43, 64, 86, 108, 129, 0, 23, 46, 70, 93, 116,
+    140, 0, 25, 50, 75, 100, 125, 150, 0, 26, 53, 80, 107, 134, 0, 28,
+    57, 85, 114, 142, 0, 30, 60, 90, 121, 151, 0, 32, 64, 96, 128, 0,
+    33, 67, 101, 135, 0, 35, 71, 106, 142, 0, 37, 74, 111, 148, 0, 38,
+    77, 116, 155, 0, 40, 81, 122, 162, 0, 42, 84, 127, 169, 0, 44, 88,
+    132, 0, 45, 91, 137, 0, 47, 95, 142, 0, 49, 98, 148, 0, 51, 102,
+    153, 0, 52, 105, 158, 0, 54, 109, 163,
+};
+
+static const int8_t lattice_node_y[302] = {
+    -4, -1, 1, 4, 6, 9, 11, 14, 16, 19, 21, 24, 26, 29, 31, 34,
+    36, 39, 41, 44, 46, 49, 51, 54, 56, 59, 61, 64, 66, -7, -4, 0,
+    3, 7, 10, 14, 17, 21, 24, 28, 31, 35, 38, 42, 45, 49, 52, 56,
+    59, 63, 66, 70, -9, -5, 0, 4, 9, 13, 18, 22, 27, 31, 36, 40,
+    45, 49, 54, 58, 63, 67, 72, -7, -2, 4, 9, 15, 20, 26, 31, 37,
+    42, 48, 53, 59, 64, 70, -8, -1, 5, 12, 18, 25, 31, 38, 44, 51,
+    57, 64, 70, -14, -6, 1, 9, 16, 24, 31, 39, 46, 54, 61, 69, 76,
+    -11, -3, 6, 14, 23, 31, 40, 48, 57, 65, 74, -16, -7, 3, 12, 22,
+    31, 41, 50, 60, 69, 79, -21, -11, 0, 10, 21, 31, 42, 52, 63, 73,
+    84, -15, -3, 8, 20, 31, 43, 54, 66, 77, -19, -6, 6, 19, 31, 44,
+    56, 69, 81, -23, -9, 4, 18, 31, 45, 58, 72, 85, -27, -12, 2, 17,
+    31, 46, 60, 75, 89, -31, -15, 0, 16, 31, 47, 62, 78, 93, -18, -2,
+    15, 31, 48, 64, 81, -21, -4, 14, 31, 49, 66, 84, -24, -6, 13, 31,
+    50, 68, 87, -27, -8, 12, 31, 51, 70, 90, -30, -10, 11, 31, 52, 72,
+    93, -33, -12, 10, 31, 53, 74, 96, -36, -14, 9, 31, 54, 76, 99, -39,
+    -16, 8, 31, 55, 78, 102, -42, -18, 7, 31, 56, 80, 105, -45, -20, 6,
+    31, 57, 82, 108, -48, -22, 5, 31, 58, 84, 111, -51, -24, 4, 31, 59,
+    86, 114, -54, -26, 3, 31, 60, 88, 117, -57, -28, 2, 31, 61, 90, 120,
+    -60, -30, 1, 31, 62, 92, 123, -63, -32, 0, 31, 63, 94, 126,
+};
@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+"""Generate lattice_tables.h: the lattice geometry of every selectable side length.
+
+Mirrors the integer arithmetic of karl-eido.c (Q16.16 columns, half pixel node rows,
+closed form visible rows), so the tables match what the app used to compute at runtime.
+
+Usage: python3 tools/gen_lattice_tables.py > lattice_tables.h
+"""
+
+SCREEN_WIDTH = 128
+SCREEN_HEIGHT = 64
+CENTER_Y = 31
+MIN_SIDE_LENGTH = 5
+MAX_SIDE_LENGTH = 63
+SIDE_LENGTH_STEP = 2
+FIXED_SHIFT = 16
+SQRT3_HALF_Q16 = 56756
+MAX_COLUMNS = ((SCREEN_WIDTH << FIXED_SHIFT) // (MIN_SIDE_LENGTH * SQRT3_HALF_Q16)) + 2
+
+
+def c_div(a, b):
+    """Integer division truncating towards zero like C."""
+    q = abs(a) // abs(b)
+    return q if (a >= 0) == (b >= 0) else -q
+
+
+def c_mod(a, b):
+    return a - b * c_div(a, b)
+
+
+def geometry(a):
+    nodes_above = c_div(2 * CENTER_Y + 1, a)
+    nodes_below = c_div(2 * (SCREEN_HEIGHT - 1 - CENTER_Y), a)
+    row_min, row_max = -nodes_above - 1, nodes_below + 1
+    full_row_min, full_row_max = 1 - nodes_above, nodes_below - 1
+    num_rows = row_max - row_min + 1
+    num_full_rows = full_row_max - full_row_min + 1
+
+    node_y = []
+    half_y = (row_min - 1) * a
+    for _ in range(num_rows + 2):
+        node_y.append(CENTER_Y + ((half_y + 1) >> 1))
+        half_y += a
+
+    column_x = [0]
+    x_q16 = 0
+    while len(column_x) - 1 < MAX_COLUMNS - 1 and column_x[-1] < SCREEN_WIDTH:
+        x_q16 += a * SQRT3_HALF_Q16
+        column_x.append(x_q16 >> FIXED_SHIFT)
+    column_count = len(column_x) - 1
+
+    full = partial = 0
+    for col in range(column_count):
+        if column_x[col + 1] < SCREEN_WIDTH:
+            full += num_full_rows
+            partial += num_rows - num_full_rows
+        else:
+            partial += num_rows
+
+    # Area of the first triangle, like lattice_cache_build() used to compute it
+    x_left, x_right = column_x[0], column_x[1]
+    if c_mod(row_min, 2) == 0:
+        v = [(x_left, node_y[0]), (x_left, node_y[2]), (x_right, node_y[1])]
+    else:
+        v = [(x_left, node_y[1]), (x_right, node_y[0]), (x_right, node_y[2])]
+    area = c_div(abs((v[1][0] - v[0][0]) * (v[2][1] - v[0][1]) -
+                     (v[2][0] - v[0][0]) * (v[1][1] - v[0][1])), 2)
+
+    return dict(column_x=column_x, node_y=node_y, row_min=row_min, row_max=row_max,
+                full_row_min=full_row_min, full_row_max=full_row_max,
+                full=full, partial=partial, area=area)
+
+
+def emit_array(ctype, name, values):
+    lines = ["static const %s %s[%d] = {" % (ctype, name, len(values))]
+    for i in range(0, len(values), 16):
+        lines.append("    " + ", ".join(str(v) for v in values[i:i + 16]) + ",")
+    lines.append("};")
+    return lines
+
+
+def main():
+    sizes = list(range(MIN_SIDE_LENGTH, MAX_SIDE_LENGTH + 1, SIDE_LENGTH_STEP))
+    entries = []
+    column_x = []
+    node_y = []
+    for a in sizes:
+        g = geometry(a)
+        assert all(0 <= x <= 255 for x in g["column_x"])
+        assert all(-128 <= y <= 127 for y in g["node_y"])
+        entries.append((a, len(column_x), len(node_y), g))
+        column_x += g["column_x"]
+        node_y += g["node_y"]
+
+    out = [
+        "// Generated by tools/gen_lattice_tables.py, do not edit",
+        "#pragma once",
+        "",
+        "#include <stdint.h>",
+        "",
+        "#define LATTICE_TABLE_MIN_SIDE_LENGTH %d" % MIN_SIDE_LENGTH,
+        "#define LATTICE_TABLE_MAX_SIDE_LENGTH %d" % MAX_SIDE_LENGTH,
+        "#define LATTICE_TABLE_SIDE_LENGTH_STEP %d" % SIDE_LENGTH_STEP,
+        "#define LATTICE_TABLE_SIZE_COUNT %d" % len(sizes),
+        "",
+        "// Geometry of one side length, arrays are slices of lattice_column_x and lattice_node_y",
+        "typedef struct {",
+        "    uint16_t column_offset; // column_count + 1 entries, the last one is the apex of the last column",
+        "    uint16_t node_offset; // row_max - row_min + 3 entries, starting at node row row_min - 1",
+        "    uint8_t column_count;",
+        "    int8_t row_min;",
+        "    int8_t row_max;",
+        "    int8_t full_row_min;",
+        "    int8_t full_row_max;",
+        "    uint16_t full_triangles;",
+        "    uint16_t partial_triangles;",
+        "    uint16_t triangle_area;",
+        "} LatticeGeometry;",
+        "",
+        "static const LatticeGeometry lattice_geometry[LATTICE_TABLE_SIZE_COUNT] = {",
+    ]
+    for a, column_offset, node_offset, g in entries:
+        out.append("    {%d, %d, %d, %d, %d, %d, %d, %d, %d, %d}, // a=%d" % (
+            column_offset, node_offset, len(g["column_x"]) - 1, g["row_min"], g["row_max"],
+            g["full_row_min"], g["full_row_max"], g["full"], g["partial"], g["area"], a))
+    out.append("};")
+    out.append("")
+    out += emit_array("uint8_t", "lattice_column_x", column_x)
+    out.append("")
+    out += emit_array("int8_t", "lattice_node_y", node_y)
+    print("\n".join(out))
+
+
+if __name__ == "__main__":
+    main()